@@ -53,6 +53,90 @@ int DAsm(char *S,byte *A);
 
 Z80 Z80_regs;
 
+//4KB z80 memory pages, NULL pages are handled by RdZ80 / WrZ80
+_u8* Z80_ReadPage[16];
+_u8* Z80_WritePage[16];
+
+static _u8 Z80_openBus[0x1000];	//Unmapped reads (always zero)
+static _u8 Z80_noWrite[0x1000];	//Unmapped writes
+
+_u32 Z80_ticks;
+
+BOOL Z80_idle;
+
+static _u32 burstEnd;		//TLCS-900h tick the current burst runs up to
+
+//=============================================================================
+
+// TLCS-900h interrupt requests made by the z80 (0xC000). A burst adds them
+// from 'intEnd', stamped with the tick they were made at. Once the burst
+// has been joined, the requests from 'intReady' are given the time they're
+// due: the first now, the rest as far apart as the z80 made them. They're
+// applied from 'intFirst' as the TLCS-900h reaches that time.
+
+#define INT_QUEUE		64		//Requests in flight, more share the last one
+
+static _u32 intTime[INT_QUEUE];	//When made, then when due
+static int intCount[INT_QUEUE];	//Requests made at that time
+static int intFirst, intReady, intEnd;
+
+//=============================================================================
+
+// Idle detection: at each mailbox poll the registers are compared with those
+// at the previous poll. If they match, the same mailbox value was read and
+// nothing has been written in between, then the z80 is in a loop that can
+// only be broken by the TLCS-900h or an interrupt. Watching for writes slows
+// down shared RAM, so it only starts once two polls in a row have matched;
+// the next matching poll then parks the z80.
+
+static Z80 spinRegs;		//Registers at the previous mailbox poll
+static _u8 spinMailbox;		//Mailbox value at the previous poll
+static int spinning;		//0, 1 after a poll, 2 once a poll has matched
+
+static void Z80_busy(void)
+{
+	spinning = 0;
+	Z80_WritePage[0x0] = ram + 0x7000;	//Stop watching writes
+}
+
+static void Z80_poll(void)
+{
+	if (spinning && spinMailbox == ram[0xBC] &&
+		spinRegs.IFF == Z80_regs.IFF && spinRegs.I == Z80_regs.I &&
+		memcmp(&spinRegs, &Z80_regs, 12 * sizeof(pair)) == 0)
+	{
+		if (spinning == 2)
+		{
+			Z80_idle = TRUE;
+			return;
+		}
+
+		//Send shared RAM writes to WrZ80 until the next poll
+		spinning = 2;
+		Z80_WritePage[0x0] = NULL;
+		return;
+	}
+
+	memcpy(&spinRegs, &Z80_regs, sizeof(Z80));
+	spinMailbox = ram[0xBC];
+	spinning = 1;
+
+	//A different loop, or none: writes needn't be watched
+	Z80_WritePage[0x0] = ram + 0x7000;
+}
+
+void Z80_wake(void)
+{
+	Z80_join();
+
+	//Use up the time spent idle
+	if (Z80_idle)
+		Z80_sync();
+
+	Z80_idle = FALSE;
+	Z80_busy();
+}
+
 //=============================================================================
 
 _u8 RdZ80(_u16 address)
@@ -66,6 +150,7 @@ _u8 RdZ80(_u16 address)
 		if (filter_sound)
 			system_debug_message("z80 <- TLCS900h: Read ... %02X", ram[0xBC]);
 #endif
+		Z80_poll();
 		return ram[0xBC];
 	}
 
@@ -78,10 +163,16 @@ void WrZ80(_u16 address, _u8 value)
 {
 	if (address <= 0x0FFF)
 	{
+		//Rewriting the same value (stack, etc.) doesn't end a polling loop
+		if (ram[0x7000 + address] != value)
+			Z80_busy();
+
 		ram[0x7000 + address] = value;
 		return;
 	}
 
+	Z80_busy();
+
 	if (address == 0x8000)
 	{
 #ifdef NEOPOP_DEBUG
@@ -92,17 +183,21 @@ void WrZ80(_u16 address, _u8 value)
 		return;
 	}
 
-	if (address == 0x4001)	{	Write_SoundChipTone(value);	return; }
-	if (address == 0x4000)	{	Write_SoundChipNoise(value); return; }
+	//The burst ends at 'burstEnd', two TLCS-900h ticks per z80 cycle
+	if (address == 0x4001)	{	Write_SoundChipTone(value, burstEnd - (Z80_regs.ICount << 1));	return; }
+	if (address == 0x4000)	{	Write_SoundChipNoise(value, burstEnd - (Z80_regs.ICount << 1)); return; }
 
-	if (address == 0xC000 && (statusIFF() <= (ram[0x71] & 0x7)))
+	//TLCS-900h interrupt, applied once the TLCS-900h has caught up
+	if (address == 0xC000)
 	{
-		interrupt(6); // Z80 Int.
-
-		if (ram[0x007C] == 0x0C)		DMA_update(0);
-		else { if (ram[0x007D] == 0x0C)	DMA_update(1);
-		else { if (ram[0x007E] == 0x0C)	DMA_update(2);
-		else { if (ram[0x007F] == 0x0C)	DMA_update(3);	}}}
+		if (intEnd == INT_QUEUE)
+		{
+			intCount[INT_QUEUE - 1]++;
+			return;
+		}
+
+		intTime[intEnd] = burstEnd - (Z80_regs.ICount << 1);
+		intCount[intEnd++] = 1;
 	}
 }
 
@@ -137,21 +232,295 @@ word LoopZ80(register Z80 *R)
 
 //=============================================================================
 
+static void Z80_map(void)
+{
+	int i;
+
+	for (i = 0; i < 16; i++)
+	{
+		Z80_ReadPage[i] = Z80_openBus;
+		Z80_WritePage[i] = Z80_noWrite;
+	}
+
+	//Shared RAM
+	Z80_ReadPage[0x0] = Z80_WritePage[0x0] = ram + 0x7000;
+
+	//Sound chips, mailbox and TLCS-900h interrupt
+	Z80_WritePage[0x4] = NULL;
+	Z80_ReadPage[0x8] = Z80_WritePage[0x8] = NULL;
+	Z80_WritePage[0xC] = NULL;
+}
+
+//=============================================================================
+
+//Schedule the requests made by the last burst. Only called with the burst
+//joined, at the same points with or without the z80 thread.
+static void Z80_schedule(void)
+{
+	_u32 lag;
+	int i;
+
+	if (intReady == intEnd)
+		return;
+
+	//Make room for the next burst
+	if (intFirst > 0)
+	{
+		memmove(intTime, intTime + intFirst, (intEnd - intFirst) * sizeof(_u32));
+		memmove(intCount, intCount + intFirst, (intEnd - intFirst) * sizeof(int));
+		intReady -= intFirst;
+		intEnd -= intFirst;
+		intFirst = 0;
+	}
+
+	//The burst ran up to the present, so the requests are all late
+	lag = TIMER_NOW - intTime[intReady];
+
+	for (i = intReady; i < intEnd; i++)
+	{
+		intTime[i] += lag;
+
+		//Not before those already due
+		if (i > 0 && (_s32)(intTime[i] - intTime[i - 1]) < 0)
+			intTime[i] = intTime[i - 1];
+	}
+
+	intReady = intEnd;
+}
+
+//Apply the z80 interrupt requests that have come due. Each is taken off
+//the queue first, DMA can write to the z80 and join again.
+static void Z80_interrupts(void)
+{
+	while (intFirst < intReady && (_s32)(intTime[intFirst] - TIMER_NOW) <= 0)
+	{
+		if (--intCount[intFirst] == 0)
+			intFirst++;
+
+		if (statusIFF() <= (ram[0x71] & 0x7))
+		{
+			interrupt(6); // Z80 Int.
+
+			if (ram[0x007C] == 0x0C)		DMA_update(0);
+			else { if (ram[0x007D] == 0x0C)	DMA_update(1);
+			else { if (ram[0x007E] == 0x0C)	DMA_update(2);
+			else { if (ram[0x007F] == 0x0C)	DMA_update(3);	}}}
+		}
+	}
+}
+
+//Hand the elapsed ticks to the z80, returns TRUE if there's work to do.
+static BOOL Z80_budget(void)
+{
+	BOOL run = FALSE;
+
+	if (Z80ACTIVE)
+	{
+		//Two TLCS-900h ticks per z80 cycle, an odd tick waits for next time
+		Z80_regs.ICount += Z80_ticks >> 1;
+		run = (Z80_regs.ICount > 0);
+		burstEnd = TIMER_NOW - (Z80_ticks & 1);
+	}
+
+	Z80_ticks &= 1;
+	return run;
+}
+
+static void Z80_burst(void)
+{
+	while (Z80_regs.ICount > 0)
+	{
+		//Parked until the TLCS-900h or an interrupt wakes it
+		if (Z80_idle || (Z80_regs.IFF & IFF_HALT))
+		{
+			Z80_regs.ICount = 0;
+			break;
+		}
+
+		ExecZ80(&Z80_regs);
+
+		//Finished the instruction after EI? Restore the saved budget.
+		if (Z80_regs.ICount <= 0 && (Z80_regs.IFF & IFF_EI))
+		{
+			Z80_regs.IFF = (Z80_regs.IFF & ~IFF_EI) | IFF_1;
+			Z80_regs.ICount += Z80_regs.IBackup - 1;
+		}
+	}
+}
+
+//=============================================================================
+
+// z80 thread: the TLCS-900h starts a burst with Z80_kick and carries on. The
+// burst only ever touches z80 state, so the TLCS-900h waits for it to finish
+// (Z80_join) before it reads or writes anything the z80 can see. That only
+// happens where they communicate: the mailbox and other comms registers,
+// shared RAM, the sound chips, NMI and IRQ, and once a frame at VBL.
+//
+// Each kick also joins the last burst before starting the next, so a burst
+// always covers the ticks since the previous kick. Kicks only depend on
+// Z80_ticks, and a join leaves the z80 exactly where the inline burst would
+// have, so the threaded and inline runs are identical.
+
+#define KICK_TICKS		(4 * TIMER_HINT_RATE)	//Smallest burst worth starting
+
+static BOOL threaded, quit;
+static BOOL burstRunning;		//Started on the z80 thread, not yet joined
+static void *semStart, *semDone;
+
+static void Z80_thread(void* param)
+{
+	for (;;)
+	{
+		system_sem_wait(semStart);
+		if (quit)
+			break;
+
+		Z80_burst();
+		system_sem_post(semDone);
+	}
+
+	system_sem_post(semDone);
+}
+
+BOOL z80_thread_start(void)
+{
+	if (threaded)
+		return TRUE;
+
+	semStart = system_sem_create(0);
+	semDone = system_sem_create(0);
+
+	if (semStart && semDone && system_thread_start(Z80_thread, NULL))
+	{
+		threaded = TRUE;
+		return TRUE;
+	}
+
+	if (semStart)	system_sem_destroy(semStart);
+	if (semDone)	system_sem_destroy(semDone);
+	return FALSE;
+}
+
+void z80_thread_stop(void)
+{
+	if (!threaded)
+		return;
+
+	Z80_join();
+
+	quit = TRUE;
+	system_sem_post(semStart);
+	system_sem_wait(semDone);
+	quit = FALSE;
+
+	system_sem_destroy(semStart);
+	system_sem_destroy(semDone);
+	threaded = FALSE;
+}
+
+void Z80_join(void)
+{
+	if (burstRunning)
+	{
+		system_sem_wait(semDone);
+		burstRunning = FALSE;
+	}
+
+	Z80_schedule();
+}
+
+//=============================================================================
+
+//Set while applying z80 interrupts, DMA can call back into Z80_sync
+static BOOL syncing;
+
+void Z80_sync(void)
+{
+	if (syncing)
+		return;
+
+	syncing = TRUE;
+	Z80_join();
+
+	if (Z80_budget())
+	{
+		Z80_burst();
+		Z80_schedule();
+	}
+
+	Z80_interrupts();
+	syncing = FALSE;
+}
+
+void Z80_kick(void)
+{
+	if (syncing)
+		return;
+
+	if (Z80_ticks >= KICK_TICKS)
+	{
+		Z80_join();
+
+		if (Z80_budget())
+		{
+			if (threaded)
+			{
+				burstRunning = TRUE;
+				system_sem_post(semStart);
+			}
+			else
+				Z80_burst();
+		}
+	}
+
+	if (intFirst < intReady)
+	{
+		syncing = TRUE;
+		Z80_interrupts();
+		syncing = FALSE;
+	}
+}
+
+//=============================================================================
+
 void Z80_nmi(void)
 {
+	Z80_sync();
+	Z80_wake();
 	IntZ80(&Z80_regs, INT_NMI);
 }
 
 void Z80_irq(void)
 {
+	Z80_sync();
+	Z80_wake();
 	Z80_regs.IFF |= IFF_1;
 	IntZ80(&Z80_regs, INT_IRQ);
 }
 
 void Z80_reset(void)
 {
+	Z80_join();
+
 	ResetZ80(&Z80_regs);
 	Z80_regs.SP.W = 0;
+	Z80_map();
+	Z80_restart();
+}
+
+void Z80_restart(void)
+{
+	Z80_join();
+
+	//The cycle budget isn't part of the machine state
+	Z80_regs.ICount = 0;
+	Z80_regs.IBackup = 0;
+	Z80_regs.IFF &= ~IFF_EI;
+	Z80_ticks = 0;
+
+	intFirst = intReady = intEnd = 0;
+	Z80_idle = FALSE;
+	Z80_busy();
 }
 
 //=============================================================================
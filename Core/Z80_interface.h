@@ -39,6 +39,10 @@
 
 void Z80_reset(void);	// z80 reset
 
+//Drop the burst in progress, with its budget and interrupt requests. Call
+//after the z80 registers or shared RAM have been replaced.
+void Z80_restart(void);
+
 void Z80_irq(void);		// Cause an interrupt
 void Z80_nmi(void);		// Cause an NMI
 
@@ -47,6 +51,34 @@ void Z80_nmi(void);		// Cause an NMI
 //Emulate a z80 instruction
 #define Z80EMULATE		{ ExecZ80(&Z80_regs); }
 
+//TLCS-900h ticks that the z80 hasn't caught up with yet.
+//The z80 runs at half the TLCS-900h clock.
+extern _u32 Z80_ticks;
+
+//Add elapsed TLCS-900h ticks to the z80 budget
+#define Z80CLOCK(TICKS)	{ Z80_ticks += (TICKS); }
+
+//Run the z80 in a burst until it has used up its cycle budget. This must
+//be called wherever the z80 and the TLCS-900h communicate.
+void Z80_sync(void);
+
+//Starts a burst with the time built up so far, left to run alongside the
+//TLCS-900h with the z80 thread. Nothing is exchanged with the TLCS-900h,
+//so it needn't be caught up. The last burst is joined first, so bursts
+//are split the same way with or without the thread. Call it often, it
+//also applies the z80's interrupt requests as they come due.
+void Z80_kick(void);
+
+//Wait for a burst started by Z80_kick. Call before touching anything the
+//z80 can see (shared RAM, z80 state).
+void Z80_join(void);
+
+//Set while the z80 is parked in a mailbox polling loop
+extern BOOL Z80_idle;
+
+//The TLCS-900h has changed something the z80 can see, resume if parked
+void Z80_wake(void);
+
 //Register status
 #define Z80_REG_AF	0
 #define Z80_REG_BC	1
@@ -69,5 +101,9 @@ char* Z80_disassemble(_u16* pc);
 
 extern Z80 Z80_regs;
 
+//z80 memory map, in 4KB pages
+extern _u8* Z80_ReadPage[16];
+extern _u8* Z80_WritePage[16];
+
 //=============================================================================
 #endif
@@ -82,6 +82,7 @@ message appear only once.
 #include "flash.h"
 #include "dma.h"
 #include "interrupt.h"
+#include "gfx.h"
 
 //=============================================================================
 
@@ -229,6 +230,8 @@ void iBIOSHLE(void)
 			_u8 a,b,c, j;
 			_u16 i, dst = 0xA000;
 
+			gfx_render_lines();	//Recorded lines see the old font
+
 			b = rCodeB(0x30) >> 4;
 			a = rCodeB(0x30) & 3;
 
@@ -246,6 +249,8 @@ void iBIOSHLE(void)
 
 				dst += 2;
 			}
+
+			gfx_tile_flush();
 		}
 		
 		break;
@@ -0,0 +1,395 @@
+//---------------------------------------------------------------------------
+// NEOPOP : Emulator as in Dreamland
+//
+// Copyright (c) 2001-2002 by neopop_uk
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+//	This program is free software; you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version. See also the license.txt file for
+//	additional informations.
+//---------------------------------------------------------------------------
+
+/*
+//---------------------------------------------------------------------------
+//=========================================================================
+
+	capture.c
+
+	Records every frame and its sound to files. The emulation only
+	copies into ring buffers, a writer thread does the conversion and the
+	file writes. Each ring has one producer and one consumer, which only
+	ever advance their own counter, so no locks are needed. A barrier
+	goes between reading the other side's counter and touching the data,
+	and between the data and advancing its own counter. When a ring
+	is full the data is dropped and counted instead of waiting, unless
+	CAPTURE_WAIT asked for every frame at whatever speed the writer
+	manages.
+
+//=========================================================================
+//---------------------------------------------------------------------------
+*/
+
+#include "neopop.h"
+#include "gfx.h"
+#include "capture.h"
+
+//=============================================================================
+
+#define CAPTURE_FRAMES	64		//Just over a second of frames
+#define AUDIO_SECONDS	2
+
+#define WAV_HEADER		44
+
+//The rings, for CAPTURE_WAIT. Each can have its own producer waiting.
+enum
+{
+	RING_FRAMES,
+	RING_SAMPLES,
+};
+
+static volatile BOOL active, quit, waiting[2];
+static void *semWork, *semDone, *semSpace[2];
+
+static void *video, *audio;
+static CAPTURE_FORMAT videoFormat, options;
+static CFB_FORMAT frameFormat;
+static int bpp;
+
+//Frame ring, SCREEN_WIDTH * SCREEN_HEIGHT pixels per frame
+static _u8* frames;
+static volatile _u32 framesWritten, framesRead;
+
+//Sound ring, always a power of 2 bytes
+static _u8* samples;
+static _u32 samplesSize;
+static volatile _u32 samplesWritten, samplesRead;
+
+static _u8* convert;		//Y4M planes for the writer
+static _u32 audioBytes, audioRate;
+static _u32 capturedFrames, droppedFrames, droppedBytes;
+
+//=============================================================================
+
+static void put32(_u8* p, _u32 data)
+{
+	p[0] = data; p[1] = data >> 8; p[2] = data >> 16; p[3] = data >> 24;
+}
+
+static void wavHeader(void)
+{
+	_u8 header[WAV_HEADER];
+
+	if (options & CAPTURE_PCM)
+		return;
+
+	memcpy(header, "RIFF....WAVEfmt ", 16);
+	put32(header + 4, audioBytes + WAV_HEADER - 8);
+	put32(header + 16, 16);
+	put32(header + 20, 1 | (2 << 16));		//PCM, stereo
+	put32(header + 24, audioRate);
+	put32(header + 28, audioRate * 4);
+	put32(header + 32, 4 | (16 << 16));		//4 bytes per sample, 16 bits
+	memcpy(header + 36, "data", 4);
+	put32(header + 40, audioBytes);
+
+	system_io_stream_seek(audio, 0);
+	system_io_stream_write(audio, header, WAV_HEADER);
+}
+
+//=============================================================================
+
+//Full range BT.601, which keeps every colour the NGP can show distinct
+static void writeY4M(_u8* frame)
+{
+	_u8 *y = convert, *u = y + (SCREEN_WIDTH * SCREEN_HEIGHT), 
+		*v = u + (SCREEN_WIDTH * SCREEN_HEIGHT);
+	int i;
+
+	for (i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++)
+	{
+		_u32 data = gfx_unpack(frameFormat, 
+			(bpp == 4) ? ((_u32*)frame)[i] : ((_u16*)frame)[i]);
+		int r = (data >> 16) & 0xFF, g = (data >> 8) & 0xFF, b = data & 0xFF;
+
+		y[i] = (r * 77 + g * 150 + b * 29 + 128) >> 8;
+		u[i] = max(0, min(255, ((b * 128 - r * 43 - g * 85 + 128) >> 8) + 128));
+		v[i] = max(0, min(255, ((r * 128 - g * 107 - b * 21 + 128) >> 8) + 128));
+	}
+
+	system_io_stream_write(video, "FRAME\n", 6);
+	system_io_stream_write(video, convert, SCREEN_WIDTH * SCREEN_HEIGHT * 3);
+}
+
+static void drain(void)
+{
+	_u32 written;
+
+	//Frames
+	for (written = framesWritten; framesRead != written; )
+	{
+		_u8* frame = frames + 
+			((framesRead % CAPTURE_FRAMES) * SCREEN_WIDTH * SCREEN_HEIGHT * bpp);
+
+		MEMORY_BARRIER();
+
+		if (videoFormat == CAPTURE_Y4M)
+			writeY4M(frame);
+		else
+			system_io_stream_write(video, frame, SCREEN_WIDTH * SCREEN_HEIGHT * bpp);
+
+		MEMORY_BARRIER();
+		framesRead++;
+	}
+
+	//Sound, in at most two pieces where the ring wraps
+	while (samplesRead != (written = samplesWritten))
+	{
+		_u32 start = samplesRead & (samplesSize - 1);
+		_u32 length = min(written - samplesRead, samplesSize - start);
+
+		MEMORY_BARRIER();
+		system_io_stream_write(audio, samples + start, length);
+		audioBytes += length;
+
+		MEMORY_BARRIER();
+		samplesRead += length;
+	}
+}
+
+static void capture_thread(void* param)
+{
+	while(1)
+	{
+		BOOL last;
+		int ring;
+
+		system_sem_wait(semWork);
+
+		//Read first, so whatever was queued before stopping is drained
+		last = quit;
+		drain();
+
+		for (ring = RING_FRAMES; ring <= RING_SAMPLES; ring++)
+		{
+			if (waiting[ring])
+			{
+				waiting[ring] = FALSE;
+				system_sem_post(semSpace[ring]);
+			}
+		}
+
+		if (last)	break;
+	}
+
+	system_sem_post(semDone);
+}
+
+//For CAPTURE_WAIT, has the writer drain and waits until it has
+static void waitForWriter(int ring)
+{
+	waiting[ring] = TRUE;
+	system_sem_post(semWork);
+	system_sem_wait(semSpace[ring]);
+}
+
+//=============================================================================
+
+void capture_frame(void)
+{
+	_u8 *src = (_u8*)cfb, *dst;
+	int y;
+
+	if (!active || video == NULL)
+		return;
+
+	while (framesWritten - framesRead == CAPTURE_FRAMES)
+	{
+		if (!(options & CAPTURE_WAIT))
+		{
+			droppedFrames++;
+			return;
+		}
+
+		waitForWriter(RING_FRAMES);
+	}
+
+	MEMORY_BARRIER();
+	dst = frames + ((framesWritten % CAPTURE_FRAMES) * SCREEN_WIDTH * SCREEN_HEIGHT * bpp);
+	for (y = 0; y < SCREEN_HEIGHT; y++)
+	{
+		memcpy(dst, src, SCREEN_WIDTH * bpp);
+		dst += SCREEN_WIDTH * bpp;
+		src += cfb_pitch;
+	}
+
+	MEMORY_BARRIER();
+	framesWritten++;
+	capturedFrames++;
+	system_sem_post(semWork);
+}
+
+void capture_sound(_u16* buffer, int count)
+{
+	_u8* src = (_u8*)buffer;
+	int length_bytes = count * 4;
+	_u32 space;
+
+	if (!active || audio == NULL)
+		return;
+
+	//Whole samples only
+	space = (samplesSize - (samplesWritten - samplesRead)) & ~3;
+	if ((_u32)length_bytes > space && !(options & CAPTURE_WAIT))
+	{
+		droppedBytes += length_bytes - space;
+		length_bytes = space;
+	}
+
+	while (length_bytes > 0)
+	{
+		_u32 start = samplesWritten & (samplesSize - 1);
+		_u32 length;
+
+		while ((space = samplesSize - (samplesWritten - samplesRead)) == 0)
+			waitForWriter(RING_SAMPLES);
+
+		length = min((_u32)length_bytes, min(space, samplesSize - start));
+
+		MEMORY_BARRIER();
+		memcpy(samples + start, src, length);
+		src += length;
+		length_bytes -= length;
+
+		MEMORY_BARRIER();
+		samplesWritten += length;
+	}
+
+	system_sem_post(semWork);
+}
+
+//=============================================================================
+
+BOOL capture_start(char* video_filename, CAPTURE_FORMAT format, 
+				   char* audio_filename, int sample_rate)
+{
+	capture_stop();
+
+	videoFormat = format & (CAPTURE_OPTIONS - 1);
+	options = format & ~(CAPTURE_OPTIONS - 1);
+	frameFormat = cfb_format;
+	bpp = CFB_PIXEL_SIZE(cfb_format);
+	audioRate = sample_rate;
+	framesWritten = framesRead = 0;
+	samplesWritten = samplesRead = 0;
+	audioBytes = capturedFrames = droppedFrames = droppedBytes = 0;
+
+	for (samplesSize = 4; samplesSize < (_u32)sample_rate * 4 * AUDIO_SECONDS; )
+		samplesSize <<= 1;
+
+	if ((semWork = system_sem_create(0)) == NULL ||
+		(semDone = system_sem_create(0)) == NULL ||
+		(semSpace[RING_FRAMES] = system_sem_create(0)) == NULL ||
+		(semSpace[RING_SAMPLES] = system_sem_create(0)) == NULL)
+	{
+		capture_stop();
+		return FALSE;
+	}
+
+	//Video
+	if (video_filename)
+	{
+		frames = (_u8*)malloc(CAPTURE_FRAMES * SCREEN_WIDTH * SCREEN_HEIGHT * bpp);
+		convert = (_u8*)malloc(SCREEN_WIDTH * SCREEN_HEIGHT * 3);
+		video = system_io_stream_open(video_filename);
+
+		if (frames == NULL || convert == NULL || video == NULL)
+		{
+			capture_stop();
+			return FALSE;
+		}
+
+		if (videoFormat == CAPTURE_Y4M)
+		{
+			char header[64];
+			sprintf(header, "YUV4MPEG2 W%d H%d F5995:100 Ip A1:1 C444\n", 
+				SCREEN_WIDTH, SCREEN_HEIGHT);
+			system_io_stream_write(video, header, strlen(header));
+		}
+	}
+
+	//Sound, the header is finished when the capture stops
+	if (audio_filename)
+	{
+		samples = (_u8*)malloc(samplesSize);
+		audio = system_io_stream_open(audio_filename);
+
+		if (samples == NULL || audio == NULL)
+		{
+			capture_stop();
+			return FALSE;
+		}
+
+		wavHeader();
+	}
+
+	if (!system_thread_start(capture_thread, NULL))
+	{
+		capture_stop();
+		return FALSE;
+	}
+
+	active = TRUE;
+	return TRUE;
+}
+
+void capture_stop(void)
+{
+	//Let the writer finish what was queued
+	if (active)
+	{
+		active = FALSE;
+		quit = TRUE;
+		system_sem_post(semWork);
+		system_sem_wait(semDone);
+		quit = FALSE;
+
+		if (droppedFrames || droppedBytes)
+			system_message("Capture: %d of %d frames and %d ms of sound dropped", 
+				droppedFrames, capturedFrames + droppedFrames, 
+				(int)(((double)droppedBytes * 250) / audioRate));
+	}
+
+	if (video)
+	{
+		system_io_stream_close(video);
+		video = NULL;
+	}
+
+	if (audio)
+	{
+		wavHeader();
+		system_io_stream_close(audio);
+		audio = NULL;
+	}
+
+	if (semWork)	system_sem_destroy(semWork);
+	if (semDone)	system_sem_destroy(semDone);
+	if (semSpace[RING_FRAMES])	system_sem_destroy(semSpace[RING_FRAMES]);
+	if (semSpace[RING_SAMPLES])	system_sem_destroy(semSpace[RING_SAMPLES]);
+	semWork = semDone = semSpace[RING_FRAMES] = semSpace[RING_SAMPLES] = NULL;
+	waiting[RING_FRAMES] = waiting[RING_SAMPLES] = FALSE;
+
+	free(frames);	frames = NULL;
+	free(convert);	convert = NULL;
+	free(samples);	samples = NULL;
+}
+
+_u32 capture_dropped(void)
+{
+	return droppedFrames;
+}
+
+//=============================================================================
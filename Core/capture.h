@@ -0,0 +1,37 @@
+//---------------------------------------------------------------------------
+// NEOPOP : Emulator as in Dreamland
+//
+// Copyright (c) 2001-2002 by neopop_uk
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+//	This program is free software; you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version. See also the license.txt file for
+//	additional informations.
+//---------------------------------------------------------------------------
+
+/*
+//---------------------------------------------------------------------------
+//=========================================================================
+
+	capture.h
+
+//=========================================================================
+//---------------------------------------------------------------------------
+*/
+
+#ifndef __CAPTURE__
+#define __CAPTURE__
+//=============================================================================
+
+//Queues 'cfb' for writing, called at VBL. Never waits for the writer.
+void capture_frame(void);
+
+//Queues 'count' stereo samples just rendered by sound_frame, so the sound
+//keeps in step with the frames whatever the output plays.
+void capture_sound(_u16* buffer, int count);
+
+//=============================================================================
+#endif
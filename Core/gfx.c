@@ -39,17 +39,16 @@
 //---------------------------------------------------------------------------
 */
 
+#include <stddef.h>
 #include "neopop.h"
 #include "mem.h"
 #include "gfx.h"
 
 //=============================================================================
 
-_u16* cfb;//[256*256];
-_u8 zbuffer[256];
-
-_u16* cfb_scanline;	//set = scanline * SCREEN_WIDTH
-_u8 scanline;
+void* cfb;
+CFB_FORMAT cfb_format = CFB_X4B4G4R4;
+int cfb_pitch = 256 * 2;
 _u8 interlace;
 
 _u8 winx = 0, winw = SCREEN_WIDTH;
@@ -64,6 +63,898 @@ _u16 r,g,b;
 
 _u8 negative;	//Negative / Positive switched?
 
+_u8 gfx_tiles[2][512 * 8][8];
+_u8 gfx_tile_valid[(512 * 8) + 2];
+
+_u8 gfx_plane[2][256][256];
+_u8 gfx_plane_tiles[512 + 1];
+BOOL gfx_plane_stale;
+BOOL gfx_plane_cache = FALSE;
+static _u16 planeMap[2][32 * 32];		//Map entries the bitmaps show
+
+_u32 gfx_sprite_gen = 1;
+_u32 gfx_palette_gen = 1;
+
+//=============================================================================
+
+//---------------------------
+// Deferred Rendering
+//---------------------------
+
+// Lines are recorded as they are due and drawn together at VBL, split into
+// bands drawn by worker threads. A VRAM page is copied before it is written
+// if recorded lines still need it, so each line sees VRAM as it was.
+// When pipelined, a frame is handed to the render thread with a snapshot of
+// VRAM and the list of character rows changed since the frame before.
+
+#define MAX_BANDS		4
+#define POOL_PAGES		128
+#define MAX_FRAMES		3
+
+typedef struct
+{
+	GFX_LINE lines[SCREEN_HEIGHT];	//Recorded, not yet drawn
+	int lineCount;
+
+	_u8 pool[POOL_PAGES][256];		//Page copies for recorded lines
+	int poolCount;
+	_u8 copyFrom[64];				//First line still reading 'ram', per page
+
+	_u8* live;						//'ram + 0x8000', or 'vram' when pipelined
+	_u8 vram[0x4000];
+	_u8 keep[(512 * 8) + 2];		//Character rows unchanged, when pipelined
+	BOOL planeStale;				//Scroll planes to be brought up to date
+}
+GFX_FRAME;
+
+//The settings a line is drawn with, from 'winx' to 'negative' in GFX_LINE
+#define LINE_REGS	(offsetof(GFX_LINE, negative) + 1 - offsetof(GFX_LINE, winx))
+
+typedef struct
+{
+	_u8 regs[LINE_REGS];
+	_u8 colour, format;
+	int pitch;
+}
+GFX_SETTINGS;
+
+static GFX_RENDERER renderer[MAX_BANDS];	//One per band, [0] also inline
+
+static BOOL deferred;
+static int bands = 1;
+
+static GFX_FRAME frame[2];
+static GFX_FRAME* rec = &frame[0];		//Being recorded
+static GFX_FRAME* job;					//Being drawn
+static BOOL frameDrawn;					//Lines drawn since VBL?
+
+static BOOL quit;
+static void *semStart[MAX_BANDS], *semDone;
+
+//Frame buffers drawn in turn
+static void* frames[MAX_FRAMES];
+static int frameCount, frameNext;
+
+//Pipelining
+static BOOL pipelined, rendering;
+static _u8 tileKeep[(512 * 8) + 2];		//Rows not written since the handover
+static void *semFrame, *semFrameDone;
+
+//Change detection. A frame looks like the one before when its lines saw
+//the same VRAM and settings, and the VRAM did not change during that one.
+static _u8 shadow[0x4000];				//VRAM as last compared
+static _u8 dirty[64];					//Pages written since, 0x80 is
+static BOOL dirtyAny;					//covered by the settings instead.
+static GFX_SETTINGS lineSettings[SCREEN_HEIGHT];	//Of each line last frame
+static void* target;					//'cfb' last frame, without a ring
+static int linesDrawn, linesBefore;
+static BOOL changed = TRUE;				//This frame differs
+static BOOL changedLate, lateBefore;	//VRAM changed after a first line
+static BOOL handedChanged;				//The frame on the render thread
+static BOOL frameChanged;				//'cfb' since the last VBL
+
+//=============================================================================
+
+//Compares the written pages with the shadow, TRUE if any differ
+static BOOL vramChanged(void)
+{
+	BOOL differs = FALSE;
+	int page;
+
+	for (page = 1; page < 64; page++)
+	{
+		_u8* data = ram + 0x8000 + (page << 8);
+
+		if (dirty[page] && memcmp(shadow + (page << 8), data, 256))
+		{
+			memcpy(shadow + (page << 8), data, 256);
+			differs = TRUE;
+		}
+	}
+
+	memset(dirty, FALSE, sizeof(dirty));
+	dirtyAny = FALSE;
+	return differs;
+}
+
+//TRUE if the latched settings differ from the same line's last frame
+static BOOL settingsChanged(const GFX_LINE* line)
+{
+	GFX_SETTINGS settings;
+
+	if (line->scanline >= SCREEN_HEIGHT)
+		return FALSE;
+
+	memset(&settings, 0, sizeof(settings));		//Padding compares too
+	memcpy(settings.regs, &line->winx, LINE_REGS);
+	settings.colour = line->colour;
+	settings.format = line->format;
+	settings.pitch = line->pitch;
+
+	if (memcmp(&lineSettings[line->scanline], &settings, sizeof(settings)) == 0)
+		return FALSE;
+
+	lineSettings[line->scanline] = settings;
+	return TRUE;
+}
+
+static void latch(GFX_LINE* line)
+{
+	int i;
+
+	line->scanline = ram[0x8009];
+	line->colour = (ram[0x6F95] == 0x10);
+	line->cfb = (frameCount) ? frames[frameNext] : cfb;
+	line->format = cfb_format;
+	line->pitch = cfb_pitch;
+
+	line->winx = winx;
+	line->winw = winw;
+	line->winy = winy;
+	line->winh = winh;
+	line->scroll1x = scroll1x;
+	line->scroll1y = scroll1y;
+	line->scroll2x = scroll2x;
+	line->scroll2y = scroll2y;
+	line->scrollsprx = scrollsprx;
+	line->scrollspry = scrollspry;
+	line->planeSwap = planeSwap;
+	line->bgc = bgc;
+	line->oowc = oowc;
+	line->negative = negative;
+
+	line->sprites = gfx_sprite_gen;
+	line->palettes = gfx_palette_gen;
+	for (i = 0; i < 64; i++)
+		line->vram[i] = ram + 0x8000 + (i << 8);
+
+	//Change detection, as this line sees it
+	if (dirtyAny && vramChanged())
+	{
+		changed = TRUE;
+		if (frameDrawn)
+			changedLate = TRUE;
+	}
+
+	if (settingsChanged(line))
+		changed = TRUE;
+
+	if (!frameCount && line->cfb != target)
+	{
+		target = line->cfb;
+		changed = TRUE;
+	}
+
+	linesDrawn++;
+}
+
+static void draw(GFX_RENDERER* r, const GFX_LINE* line)
+{
+	int i;
+
+	r->line = line;
+
+	//Lines that see the maps and characters as cached use the bitmaps
+	r->planes = gfx_plane_cache;
+	for (i = 0x10; i < 0x40 && r->planes; i++)
+		r->planes = (line->vram[i] == r->cached + (i << 8));
+
+	gfx_draw_scanline_mode(r);
+}
+
+static void drawBand(GFX_RENDERER* r)
+{
+	int band = r - renderer;
+	int i, last = (job->lineCount * (band + 1)) / bands;
+
+	r->cached = job->live;
+	for (i = (job->lineCount * band) / bands; i < last; i++)
+		draw(r, &job->lines[i]);
+}
+
+static void gfx_thread(void* param)
+{
+	GFX_RENDERER* r = (GFX_RENDERER*)param;
+
+	while(1)
+	{
+		system_sem_wait(semStart[r - renderer]);
+		if (quit)
+			break;
+
+		drawBand(r);
+		system_sem_post(semDone);
+	}
+
+	system_sem_post(semDone);
+}
+
+static void renderFrame(GFX_FRAME* f)
+{
+	int i;
+
+	job = f;
+
+	//Bring the character cache up to the snapshot
+	if (f->live != ram + 0x8000)
+	{
+		for (i = 0; i < 512 * 8; i++)
+		{
+			if (!f->keep[i])
+			{
+				gfx_tile_valid[i] = FALSE;
+				gfx_plane_tiles[i >> 3] = TRUE;
+			}
+		}
+	}
+
+	if (f->planeStale)
+		gfx_plane_update(f->live);
+
+	if (bands > 1)
+	{
+		//Fill the character cache, the bands only read it
+		for (i = 0; i < 512 * 8; i++)
+			if (!gfx_tile_valid[i])
+				gfx_tile_decode(f->live, i);
+
+		for (i = 1; i < bands; i++)
+			system_sem_post(semStart[i]);
+
+		drawBand(&renderer[0]);
+
+		for (i = 1; i < bands; i++)
+			system_sem_wait(semDone);
+	}
+	else
+		drawBand(&renderer[0]);
+}
+
+static void gfx_pipeline_thread(void* param)
+{
+	while(1)
+	{
+		system_sem_wait(semFrame);
+		if (quit)
+			break;
+
+		renderFrame(job);
+		system_sem_post(semFrameDone);
+	}
+
+	system_sem_post(semFrameDone);
+}
+
+//Wait for the render thread to finish the frame it was given
+static void pipeline_join(void)
+{
+	if (rendering)
+	{
+		system_sem_wait(semFrameDone);
+		rendering = FALSE;
+	}
+}
+
+//Make 'f' independent of 'ram' for the render thread
+static void snapshot(GFX_FRAME* f)
+{
+	int i, page;
+
+	memcpy(f->vram, ram + 0x8000, 0x4000);
+	for (page = 0; page < 64; page++)
+		for (i = f->copyFrom[page]; i < f->lineCount; i++)
+			f->lines[i].vram[page] = f->vram + (page << 8);
+
+	f->live = f->vram;
+
+	memcpy(f->keep, tileKeep, sizeof(tileKeep));
+	memset(tileKeep, TRUE, sizeof(tileKeep));
+}
+
+//=============================================================================
+
+void gfx_draw_scanline(void)
+{
+	static GFX_LINE line;
+
+	if (!deferred)
+	{
+		latch(&line);
+		renderer[0].cached = ram + 0x8000;
+
+		if (gfx_plane_cache && gfx_plane_stale)
+		{
+			gfx_plane_stale = FALSE;
+			gfx_plane_update(ram + 0x8000);
+		}
+
+		draw(&renderer[0], &line);
+		frameDrawn = TRUE;
+		return;
+	}
+
+	if (rec->lineCount == SCREEN_HEIGHT)
+		gfx_render_lines();
+
+	latch(&rec->lines[rec->lineCount++]);
+	frameDrawn = TRUE;
+}
+
+void gfx_render_lines(void)
+{
+	GFX_FRAME* f = rec;
+
+	if (f->lineCount == 0)
+		return;
+
+	//Whoever draws the lines brings the scroll planes up to date
+	f->planeStale = gfx_plane_cache && gfx_plane_stale;
+	if (f->planeStale)
+		gfx_plane_stale = FALSE;
+
+	if (pipelined)
+	{
+		//Hand the lines over, and record into the other frame
+		pipeline_join();
+		snapshot(f);
+
+		job = f;
+		rendering = TRUE;
+		system_sem_post(semFrame);
+
+		rec = (f == &frame[0]) ? &frame[1] : &frame[0];
+		f = rec;
+	}
+	else
+	{
+		f->live = ram + 0x8000;
+		renderFrame(f);
+	}
+
+	f->lineCount = 0;
+	f->poolCount = 0;
+	memset(f->copyFrom, 0, sizeof(f->copyFrom));
+}
+
+void gfx_end_frame(void)
+{
+	BOOL same = frameDrawn && !changed && !lateBefore && 
+		linesDrawn == linesBefore;
+
+	//Lines drawn mid frame went to the next buffer, finish it
+	if (deferred && rec->lineCount != linesDrawn)
+		same = FALSE;
+
+	if (same)
+	{
+		//The frame shown already looks like this one, drop it
+		if (deferred)
+		{
+			rec->lineCount = 0;
+			rec->poolCount = 0;
+			memset(rec->copyFrom, 0, sizeof(rec->copyFrom));
+		}
+
+		//Unless the last frame handed over is still to be shown
+		if (pipelined)
+		{
+			pipeline_join();
+			cfb = frames[(frameNext + frameCount - 1) % frameCount];
+		}
+
+		frameChanged = pipelined && handedChanged;
+		handedChanged = FALSE;
+	}
+	else
+	{
+		gfx_render_lines();
+
+		if (frameCount && frameDrawn)
+		{
+			//Show the newest complete frame, the one before when pipelined
+			if (pipelined)
+				cfb = frames[(frameNext + frameCount - 1) % frameCount];
+			else
+				cfb = frames[frameNext];
+
+			frameNext = (frameNext + 1) % frameCount;
+		}
+
+		if (!frameDrawn)
+			frameChanged = FALSE;
+		else if (pipelined)
+		{
+			frameChanged = handedChanged;
+			handedChanged = TRUE;
+		}
+		else
+			frameChanged = TRUE;
+	}
+
+	if (frameDrawn)
+	{
+		lateBefore = changedLate;
+		linesBefore = linesDrawn;
+		changed = changedLate = FALSE;
+		linesDrawn = 0;
+	}
+
+	frameDrawn = FALSE;
+}
+
+BOOL gfx_frame_changed(void)
+{
+	return frameChanged;
+}
+
+static void copyPage(int page)
+{
+	int i;
+
+	//Every line recorded since the last copy reads 'ram'
+	if (rec->copyFrom[page] == rec->lineCount)
+		return;
+
+	//Out of copies, draw the lines now instead
+	if (rec->poolCount == POOL_PAGES)
+	{
+		gfx_render_lines();
+		return;
+	}
+
+	memcpy(rec->pool[rec->poolCount], ram + 0x8000 + (page << 8), 256);
+	for (i = rec->copyFrom[page]; i < rec->lineCount; i++)
+		rec->lines[i].vram[page] = rec->pool[rec->poolCount];
+
+	rec->poolCount++;
+	rec->copyFrom[page] = rec->lineCount;
+}
+
+void gfx_vram_write(_u32 address)
+{
+	dirty[(address >> 8) & 0x3F] = TRUE;
+	if ((address & 0xFF) > 0xFC && address < 0xBF00)
+		dirty[((address >> 8) + 1) & 0x3F] = TRUE;
+	dirtyAny = TRUE;
+
+	//Recorded lines must still see the old data
+	if (rec->lineCount)
+	{
+		copyPage((address >> 8) & 0x3F);
+		if ((address & 0xFF) > 0xFC && address < 0xBF00)
+			copyPage(((address >> 8) + 1) & 0x3F);
+	}
+
+	//Sprite table
+	if (address + 3 >= 0x8800 && address <= 0x88FF)
+		gfx_sprite_gen++;
+
+	//Palettes (mono and colour)
+	if (address + 3 >= 0x8100 && address <= 0x83FF)
+		gfx_palette_gen++;
+
+	//Scroll plane maps and characters
+	if (address >= 0x9000)
+		gfx_plane_stale = TRUE;
+
+	//Character RAM, drop the decoded rows. The render thread owns the
+	//cache when pipelined, it is told about the rows with the frame.
+	if (address >= 0xA000)
+	{
+		if (pipelined)
+		{
+			_u8* valid = tileKeep + ((address - 0xA000) >> 1);
+			valid[0] = valid[1] = valid[2] = FALSE;
+		}
+		else
+		{
+			gfx_tile_invalidate(address);
+			gfx_plane_tiles[(address - 0xA000) >> 4] = TRUE;
+			gfx_plane_tiles[(address - 0xA000 + 3) >> 4] = TRUE;
+		}
+	}
+}
+
+//=============================================================================
+
+BOOL gfx_deferred_start(int count)
+{
+	gfx_deferred_stop();
+	count = max(1, min(count, MAX_BANDS));
+
+	if (count > 1 && (semDone = system_sem_create(0)) == NULL)
+		return FALSE;
+
+	while (bands < count)
+	{
+		if ((semStart[bands] = system_sem_create(0)) == NULL)
+			break;
+
+		if (!system_thread_start(gfx_thread, &renderer[bands]))
+		{
+			system_sem_destroy(semStart[bands]);
+			break;
+		}
+
+		bands++;
+	}
+
+	deferred = TRUE;
+
+	if (bands < count)
+	{
+		gfx_deferred_stop();
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void gfx_deferred_stop(void)
+{
+	int i;
+
+	if (!deferred)
+		return;
+
+	//Finish the frame
+	gfx_pipeline_stop();
+	gfx_render_lines();
+
+	quit = TRUE;
+	for (i = 1; i < bands; i++)
+	{
+		system_sem_post(semStart[i]);
+		system_sem_wait(semDone);
+		system_sem_destroy(semStart[i]);
+	}
+	quit = FALSE;
+
+	if (semDone)
+	{
+		system_sem_destroy(semDone);
+		semDone = NULL;
+	}
+
+	bands = 1;
+	deferred = FALSE;
+}
+
+BOOL gfx_frame_buffer(const CFB_DESC* desc)
+{
+	//Buffers set by gfx_frame_buffers keep the layout they were set with
+	if (frameCount)
+		return FALSE;
+
+	if (desc->base == NULL || 
+		desc->width < SCREEN_WIDTH || desc->height < SCREEN_HEIGHT ||
+		desc->pitch < desc->width * CFB_PIXEL_SIZE(desc->format) ||
+		desc->pitch % CFB_PIXEL_SIZE(desc->format))
+		return FALSE;
+
+	//Lines already recorded keep the layout they were latched with
+	cfb = desc->base;
+	cfb_format = desc->format;
+	cfb_pitch = desc->pitch;
+	changed = TRUE;
+	return TRUE;
+}
+
+BOOL gfx_frame_buffers(void** buffers, int count)
+{
+	int i;
+
+	//The render thread draws to them
+	if (pipelined || count == 1 || count > MAX_FRAMES)
+		return FALSE;
+
+	for (i = 0; i < count; i++)
+		frames[i] = buffers[i];
+
+	frameCount = count;
+	frameNext = 0;
+	changed = TRUE;
+	return TRUE;
+}
+
+BOOL gfx_pipeline_start(void)
+{
+	gfx_pipeline_stop();
+
+	//The newest frame must not be drawn over for a whole frame
+	if (!deferred || frameCount < 3)
+		return FALSE;
+
+	memset(tileKeep, TRUE, sizeof(tileKeep));
+	changed = TRUE;
+
+	semFrame = system_sem_create(0);
+	semFrameDone = system_sem_create(0);
+
+	if (semFrame && semFrameDone && 
+		system_thread_start(gfx_pipeline_thread, NULL))
+	{
+		//Draw the lines already recorded first
+		gfx_render_lines();
+
+		pipelined = TRUE;
+		return TRUE;
+	}
+
+	if (semFrame)		system_sem_destroy(semFrame);
+	if (semFrameDone)	system_sem_destroy(semFrameDone);
+	return FALSE;
+}
+
+void gfx_pipeline_stop(void)
+{
+	int i;
+
+	if (!pipelined)
+		return;
+
+	//Hand over what is left, then wait for it
+	gfx_render_lines();
+	pipeline_join();
+
+	quit = TRUE;
+	system_sem_post(semFrame);
+	system_sem_wait(semFrameDone);
+	quit = FALSE;
+
+	system_sem_destroy(semFrame);
+	system_sem_destroy(semFrameDone);
+
+	//The cache is back in step with 'ram'
+	for (i = 0; i < 512 * 8; i++)
+	{
+		if (!tileKeep[i])
+		{
+			gfx_tile_valid[i] = FALSE;
+			gfx_plane_tiles[i >> 3] = TRUE;
+		}
+	}
+
+	//Show the newest complete frame
+	cfb = frames[(frameNext + frameCount - 1) % frameCount];
+	pipelined = FALSE;
+	changed = TRUE;
+}
+
+//=============================================================================
+
+_u32 gfx_convert(_u8 format, _u16 data16)
+{
+	_u32 r = data16 & 0xF, g = (data16 >> 4) & 0xF, b = (data16 >> 8) & 0xF;
+
+	switch (format)
+	{
+	default:
+	case CFB_X4B4G4R4:
+		return data16;
+
+	case CFB_R5G6B5:
+		return (((r << 1) | (r >> 3)) << 11) | (((g << 2) | (g >> 2)) << 5) | 
+			((b << 1) | (b >> 3));
+
+	case CFB_X1R5G5B5:
+		return 0x8000 | (((r << 1) | (r >> 3)) << 10) | 
+			(((g << 1) | (g >> 3)) << 5) | ((b << 1) | (b >> 3));
+
+	case CFB_X8R8G8B8:
+		return 0xFF000000 | ((r * 0x11) << 16) | ((g * 0x11) << 8) | (b * 0x11);
+	}
+}
+
+_u32 gfx_unpack(_u8 format, _u32 data)
+{
+	_u32 r, g, b;
+
+	switch (format)
+	{
+	default:
+	case CFB_X4B4G4R4:
+		r = (data & 0xF) * 0x11;
+		g = ((data >> 4) & 0xF) * 0x11;
+		b = ((data >> 8) & 0xF) * 0x11;
+		break;
+
+	case CFB_R5G6B5:
+		r = ((data >> 11) << 3) | (data >> 13);
+		g = (((data >> 5) & 0x3F) << 2) | ((data >> 9) & 3);
+		b = ((data & 0x1F) << 3) | ((data >> 2) & 7);
+		break;
+
+	case CFB_X1R5G5B5:
+		r = (((data >> 10) & 0x1F) << 3) | ((data >> 12) & 7);
+		g = (((data >> 5) & 0x1F) << 3) | ((data >> 7) & 7);
+		b = ((data & 0x1F) << 3) | ((data >> 2) & 7);
+		break;
+
+	case CFB_X8R8G8B8:
+		return data;
+	}
+
+	return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
+
+//Convert the composited line to colours, in one pass
+void gfx_resolve(GFX_RENDERER* r)
+{
+	const GFX_LINE* line = r->line;
+	void* out = (_u8*)line->cfb + (line->scanline * line->pitch);
+	int x;
+
+	if (line->format == CFB_X8R8G8B8)
+	{
+		for (x = 0; x < SCREEN_WIDTH; x++)
+			((_u32*)out)[x] = r->palette[r->ibuffer[x]];
+	}
+	else
+	{
+		for (x = 0; x < SCREEN_WIDTH; x++)
+			((_u16*)out)[x] = (_u16)r->palette[r->ibuffer[x]];
+	}
+}
+
+//=============================================================================
+
+//Decodes a row into the cache, 'vram' is 0x8000 of the VRAM it caches
+void gfx_tile_decode(_u8* vram, _u16 index)
+{
+	_u16 data = *(_u16*)(vram + 0x2000 + (index << 1));
+	_u8 x, pixel;
+
+	for (x = 0; x < 8; x++)
+	{
+		pixel = (data >> (14 - (x << 1))) & 3;
+		gfx_tiles[0][index][x] = pixel;
+		gfx_tiles[1][index][7 - x] = pixel;
+	}
+
+	gfx_tile_valid[index] = TRUE;
+}
+
+//Decodes a row from a copied page into the renderer, bypassing the cache
+void gfx_tile_copy(GFX_RENDERER* r, _u8* data, _u16 mirror)
+{
+	_u16 data16 = *(_u16*)data;
+	_u8 x;
+
+	for (x = 0; x < 8; x++)
+		r->tile[mirror ? 7 - x : x] = (data16 >> (14 - (x << 1))) & 3;
+}
+
+//Forget every decoded row, for bulk changes to the character RAM
+void gfx_tile_flush(void)
+{
+	memset((pipelined) ? tileKeep : gfx_tile_valid, FALSE, sizeof(tileKeep));
+	if (!pipelined)
+		memset(gfx_plane_tiles, TRUE, sizeof(gfx_plane_tiles));
+	gfx_plane_stale = TRUE;
+
+	//All of the VRAM may have changed
+	memset(dirty, TRUE, sizeof(dirty));
+	dirtyAny = TRUE;
+}
+
+//=============================================================================
+
+//Decodes the cells whose map entry or character changed
+void gfx_plane_update(_u8* vram)
+{
+	int plane, cell, y, x;
+
+	for (plane = 0; plane < 2; plane++)
+	{
+		_u16* map = (_u16*)(vram + 0x1000 + (plane << 11));
+
+		for (cell = 0; cell < 32 * 32; cell++)
+		{
+			_u16 data16 = map[cell];
+			_u16 tile = data16 & 0x01FF;
+			_u8 palette = (data16 >> 7) & 0x7C;
+
+			if (planeMap[plane][cell] == data16 && !gfx_plane_tiles[tile])
+				continue;
+
+			planeMap[plane][cell] = data16;
+
+			for (y = 0; y < 8; y++)
+			{
+				_u16 index = (tile << 3) + ((data16 & 0x4000) ? 7 - y : y);
+				_u8* out = &gfx_plane[plane][((cell >> 5) << 3) + y][(cell & 31) << 3];
+				_u8* pixel;
+
+				if (!gfx_tile_valid[index])
+					gfx_tile_decode(vram, index);
+
+				pixel = gfx_tiles[(data16 & 0x8000) ? 1 : 0][index];
+				for (x = 0; x < 8; x++)
+					out[x] = (pixel[x]) ? (palette | pixel[x]) : 0;
+			}
+		}
+	}
+
+	memset(gfx_plane_tiles, FALSE, sizeof(gfx_plane_tiles));
+}
+
+//=============================================================================
+
+void gfx_sprite_lists(GFX_RENDERER* r)
+{
+	const GFX_LINE* line = r->line;
+	_u8* table = VRAM(line, 0x8800);
+	_s16 lastSpriteX;
+	_s16 lastSpriteY;
+	int spr, ln;
+
+	memset(r->sprite_count, 0, sizeof(r->sprite_count));
+
+	//Last sprite position, (defaults to top-left, sure?)
+	lastSpriteX = 0;
+	lastSpriteY = 0;
+	for (spr = 0; spr < 64; spr++)
+	{
+		_u8 sx = table[(spr * 4) + 2];	//X position
+		_u8 sy = table[(spr * 4) + 3];	//Y position
+		_s16 x = sx;
+		_s16 y = sy;
+		_u16 data16;
+
+		data16 = *(_u16*)(table + (spr * 4));
+
+		if (data16 & 0x0400) x = lastSpriteX + sx;	//Horizontal chain?
+		if (data16 & 0x0200) y = lastSpriteY + sy;	//Vertical chain?
+
+		//Store the position for chaining
+		lastSpriteX = x;
+		lastSpriteY = y;
+
+		//Visible?
+		if ((data16 & 0x1800) == 0)	continue;
+
+		//Scroll the sprite
+		x += line->scrollsprx;
+		y += line->scrollspry;
+
+		//Off-screen?
+		if (x > 248 && x < 256)	x = x - 256; else x &= 0xFF;
+		if (y > 248 && y < 256)	y = y - 256; else y &= 0xFF;
+
+		r->sprite_x[spr] = (_u8)x;
+		r->sprite_y[spr] = y;
+
+		//List it on the lines it covers
+		for (ln = max(y, 0); ln <= min(y + 7, 255); ln++)
+			r->sprite_list[ln][r->sprite_count[ln]++] = spr;
+	}
+
+	r->sprites = line->sprites;
+	r->sprx = line->scrollsprx;
+	r->spry = line->scrollspry;
+}
+
 //=============================================================================
 
 void gfx_delayed_settings(void)
@@ -55,10 +55,6 @@
 // Common Graphics Variables
 //---------------------------
 
-extern _u8 zbuffer[256];	//Line z-buffer
-extern _u16* cfb_scanline;	//set = cfb + (scanline * SCREEN_WIDTH)
-
-extern _u8 scanline;		//Current scanline
 extern _u8 interlace;		//which scanlines are drawn (even or odd)
 
 extern _u8 winx, winw;
@@ -75,8 +71,174 @@ void gfx_delayed_settings(void);
 
 //=============================================================================
 
-void gfx_draw_scanline_colour(void);
-void gfx_draw_scanline_mono(void);
+//---------------------------
+// Scanline State
+//---------------------------
+
+//Everything a scanline is drawn from, latched when it is due to be drawn.
+typedef struct
+{
+	_u8 scanline;
+	_u8 colour;				//K2GE colour mode?
+	void* cfb;				//Frame buffer to draw to
+	_u8 format;				//... its CFB_FORMAT
+	int pitch;
+
+	_u8 winx, winw;
+	_u8 winy, winh;
+	_u8 scroll1x, scroll1y;
+	_u8 scroll2x, scroll2y;
+	_u8 scrollsprx, scrollspry;
+	_u8 planeSwap;
+	_u8 bgc, oowc, negative;
+
+	_u32 sprites;			//gfx_sprite_gen, identifies the sprite table
+	_u32 palettes;			//gfx_palette_gen, identifies the palette RAM
+	_u8* vram[64];			//0x8000 - 0xBFFF in 256 byte pages, either 'ram'
+							//or a copy made before a later write.
+}
+GFX_LINE;
+
+//Video RAM (0x8000 - 0xBFFF) as seen by a line
+#define VRAM(line, address)	\
+	((line)->vram[((address) >> 8) & 0x3F] + ((address) & 0xFF))
+
+//Working state of one thread drawing lines
+typedef struct
+{
+	const GFX_LINE* line;	//Line being drawn
+	_u8* cached;			//0x8000 - 0xBFFF as in the character cache
+
+	_u8 zbuffer[256];		//Line z-buffer
+	_u8 ibuffer[256];		//Line palette index buffer, resolved to cfb
+	_u8 tile[8];			//A row decoded from a copied page
+	BOOL planes;			//Line can be copied from gfx_plane
+
+	//Output colour of each ibuffer entry, rebuilt when the palette RAM,
+	//'negative' or the colour mode changes.
+	_u32 palettes;
+	_u8 palNegative, palColour, palFormat;
+	_u32 palette[256];
+
+	//Sprite lists, see gfx_sprite_lists
+	_u32 sprites;
+	_u8 sprx, spry;
+	_u8 sprite_x[64];			//Screen position
+	_s16 sprite_y[64];
+	_u8 sprite_count[256];		//Visible sprites for each line
+	_u8 sprite_list[256][64];	//... in drawing order
+}
+GFX_RENDERER;
+
+void gfx_draw_scanline(void);	//Draws, or records, the current scanline
+void gfx_render_lines(void);	//Draws the recorded lines
+void gfx_end_frame(void);		//At VBL
+void gfx_vram_write(_u32 address);
+
+//=============================================================================
+
+//---------------------------
+// Decoded Character Cache
+//---------------------------
+
+//Each row of the 512 characters at 0xA000 expanded to one 2-bit colour
+//index per byte, left to right and mirrored (right to left).
+extern _u8 gfx_tiles[2][512 * 8][8];
+extern _u8 gfx_tile_valid[(512 * 8) + 2];	//Two spare, see gfx_tile_invalidate
+
+void gfx_tile_decode(_u8* vram, _u16 index);
+void gfx_tile_copy(GFX_RENDERER* r, _u8* data, _u16 mirror);
+void gfx_tile_flush(void);
+
+//Called for every write to the character RAM (0xA000 - 0xBFFF). A long
+//write to an odd address can touch three rows.
+#define gfx_tile_invalidate(address)	\
+{										\
+	_u8* valid = gfx_tile_valid + (((address) - 0xA000) >> 1);	\
+	valid[0] = valid[1] = valid[2] = FALSE;	\
+}
+
+//Returns the 8 decoded pixels of the "tiley'th" line of "tile"
+static __inline _u8* gfx_tile_row(GFX_RENDERER* r, _u16 tile, _u8 tiley, 
+								  _u16 mirror)
+{
+	_u16 index = (tile << 3) + tiley;
+	_u8* page = r->line->vram[0x20 + (tile >> 4)];
+
+	//Page copied before a later write, not what the cache holds
+	if (page != r->cached + 0x2000 + ((tile >> 4) << 8))
+	{
+		gfx_tile_copy(r, page + ((index << 1) & 0xFF), mirror);
+		return r->tile;
+	}
+
+	if (!gfx_tile_valid[index])
+		gfx_tile_decode(r->cached, index);
+
+	return gfx_tiles[mirror ? 1 : 0][index];
+}
+
+//=============================================================================
+
+//---------------------------
+// Scroll Plane Bitmaps
+//---------------------------
+
+//Both 256x256 scroll planes decoded whole, one byte per pixel holding the
+//2-bit colour index, with bits 9 - 13 of the map entry in bits 2 - 6 (the
+//colour palette in 2 - 5, the mono palette in 6). Brought up to date with
+//the VRAM the character cache holds, when gfx_plane_cache is set.
+extern _u8 gfx_plane[2][256][256];
+extern _u8 gfx_plane_tiles[512 + 1];	//Characters written, one spare
+extern BOOL gfx_plane_stale;			//Map or characters written
+
+void gfx_plane_update(_u8* vram);
+
+//=============================================================================
+
+//---------------------------
+// Sprite Visibility Lists
+//---------------------------
+
+//Sprites are resolved (chaining, offset and wrapping) only when the table
+//at 0x8800 or the sprite offset changes, then listed per scanline.
+extern _u32 gfx_sprite_gen;		//Bumped on every change to the table
+
+void gfx_sprite_lists(GFX_RENDERER* r);
+
+static __inline void gfx_sprites(GFX_RENDERER* r)
+{
+	const GFX_LINE* line = r->line;
+
+	if (r->sprites != line->sprites || 
+		r->sprx != line->scrollsprx || r->spry != line->scrollspry)
+		gfx_sprite_lists(r);
+}
+
+//=============================================================================
+
+//---------------------------
+// Resolved Palettes
+//---------------------------
+
+extern _u32 gfx_palette_gen;	//Bumped on every change to 0x8100 - 0x83FF
+
+_u32 gfx_convert(_u8 format, _u16 data16);	//From X4B4G4R4
+_u32 gfx_unpack(_u8 format, _u32 data);		//To X8R8G8B8
+void gfx_resolve(GFX_RENDERER* r);			//ibuffer to the frame buffer
+
+static __inline BOOL gfx_palette_valid(GFX_RENDERER* r, _u8 colour)
+{
+	const GFX_LINE* line = r->line;
+
+	return r->palettes == line->palettes && r->palColour == colour && 
+		r->palNegative == line->negative && r->palFormat == line->format;
+}
+
+//=============================================================================
+
+//Either mode, K1GE mono or K2GE colour as latched
+void gfx_draw_scanline_mode(GFX_RENDERER* r);
 
 //=============================================================================
 #endif
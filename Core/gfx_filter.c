@@ -0,0 +1,781 @@
+//---------------------------------------------------------------------------
+// NEOPOP : Emulator as in Dreamland
+//
+// Copyright (c) 2001-2002 by neopop_uk
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+//	This program is free software; you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version. See also the license.txt file for
+//	additional informations.
+//---------------------------------------------------------------------------
+
+/*
+//---------------------------------------------------------------------------
+//=========================================================================
+
+	gfx_filter.c
+
+	Scales a finished frame up for display, in any of the cfb formats.
+	The frame is split into bands of rows, all but one scaled by worker
+	threads. With SSE2 or NEON each row is done a vector of pixels at a
+	time, the PSP uses the plain C versions.
+
+//=========================================================================
+//---------------------------------------------------------------------------
+*/
+
+#include "neopop.h"
+#include "gfx.h"
+
+//=============================================================================
+
+#define MAX_THREADS		4
+#define MAX_SCALE		8
+
+typedef struct
+{
+	FILTER filter;
+	int scale, bpp;
+	const _u8* src;
+	int srcPitch;
+	_u8* dst;
+	int dstPitch;
+}
+JOB;
+
+static JOB job;
+static int threads = 1;
+static int band[MAX_THREADS];
+static BOOL quit;
+static void *semStart[MAX_THREADS], *semDone;
+
+//The xBR filter works on the frame as X8R8G8B8, with a 2 pixel border
+//copied from the edges, and the YUV of each pixel for comparisons.
+#define XW	(SCREEN_WIDTH + 4)
+#define XH	(SCREEN_HEIGHT + 4)
+static _u32 rgb[XH][XW];
+static _u32 yuv[XH][XW];
+
+//=============================================================================
+
+//---------------------------
+// SIMD
+//---------------------------
+
+//The filters only compare, select and interleave pixels, and xBR adds up
+//differences of 10-bit fields, so the same code runs on 128-bit vectors of
+//8 16-bit or 4 32-bit pixels for SSE2 and NEON. The first and last columns
+//repeat the frame edge and stay scalar.
+
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+#define FILTER_SIMD
+
+typedef __m128i VEC;
+
+#define VLOAD(p)			_mm_loadu_si128((const __m128i*)(p))
+#define VSTORE(p, v)		_mm_storeu_si128((__m128i*)(p), (v))
+#define VOR(a, b)			_mm_or_si128((a), (b))
+#define VANDNOT(m, a)		_mm_andnot_si128((m), (a))		//~m & a
+#define VSEL(m, a, b)		VOR(_mm_and_si128((m), (a)), VANDNOT((m), (b)))
+#define VEQ_u16(a, b)			_mm_cmpeq_epi16((a), (b))
+#define VEQ_u32(a, b)			_mm_cmpeq_epi32((a), (b))
+#define VZIP_u16(a, b, lo, hi)	\
+	{ VEC l = _mm_unpacklo_epi16((a), (b)); hi = _mm_unpackhi_epi16((a), (b)); lo = l; }
+#define VZIP_u32(a, b, lo, hi)	\
+	{ VEC l = _mm_unpacklo_epi32((a), (b)); hi = _mm_unpackhi_epi32((a), (b)); lo = l; }
+
+#define VSET32(n)			_mm_set1_epi32(n)
+#define VAND(a, b)			_mm_and_si128((a), (b))
+#define VADD32(a, b)		_mm_add_epi32((a), (b))
+#define VSUB32(a, b)		_mm_sub_epi32((a), (b))
+#define VSHL32(a, n)		_mm_slli_epi32((a), (n))
+#define VSHR32(a, n)		_mm_srli_epi32((a), (n))
+#define VLT32(a, b)			_mm_cmplt_epi32((a), (b))	//Both below 1 << 31
+
+static __inline VEC VABD32(VEC a, VEC b)
+{
+	VEC d = _mm_sub_epi32(a, b), s = _mm_srai_epi32(d, 31);
+	return _mm_sub_epi32(_mm_xor_si128(d, s), s);
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+#define FILTER_SIMD
+
+typedef uint8x16_t VEC;
+
+#define U16(v)				vreinterpretq_u16_u8(v)
+#define U32(v)				vreinterpretq_u32_u8(v)
+#define V16(v)				vreinterpretq_u8_u16(v)
+#define V32(v)				vreinterpretq_u8_u32(v)
+
+#define VLOAD(p)			vld1q_u8((const uint8_t*)(p))
+#define VSTORE(p, v)		vst1q_u8((uint8_t*)(p), (v))
+#define VOR(a, b)			vorrq_u8((a), (b))
+#define VANDNOT(m, a)		vbicq_u8((a), (m))				//~m & a
+#define VSEL(m, a, b)		vbslq_u8((m), (a), (b))
+#define VEQ_u16(a, b)			V16(vceqq_u16(U16(a), U16(b)))
+#define VEQ_u32(a, b)			V32(vceqq_u32(U32(a), U32(b)))
+#define VZIP_u16(a, b, lo, hi)	\
+	{ uint16x8x2_t z = vzipq_u16(U16(a), U16(b)); lo = V16(z.val[0]); hi = V16(z.val[1]); }
+#define VZIP_u32(a, b, lo, hi)	\
+	{ uint32x4x2_t z = vzipq_u32(U32(a), U32(b)); lo = V32(z.val[0]); hi = V32(z.val[1]); }
+
+#define VSET32(n)			V32(vdupq_n_u32(n))
+#define VAND(a, b)			vandq_u8((a), (b))
+#define VADD32(a, b)		V32(vaddq_u32(U32(a), U32(b)))
+#define VSUB32(a, b)		V32(vsubq_u32(U32(a), U32(b)))
+#define VSHL32(a, n)		V32(vshlq_n_u32(U32(a), (n)))
+#define VSHR32(a, n)		V32(vshrq_n_u32(U32(a), (n)))
+#define VLT32(a, b)			V32(vcltq_u32(U32(a), U32(b)))
+#define VABD32(a, b)		V32(vabdq_u32(U32(a), U32(b)))
+
+static __inline BOOL VALL(VEC m)
+{
+	uint8x8_t both = vand_u8(vget_low_u8(m), vget_high_u8(m));
+	return vget_lane_u64(vreinterpret_u64_u8(both), 0) == ~(uint64_t)0;
+}
+
+#endif
+
+#if defined(__SSE2__)
+#define VALL(m)				(_mm_movemask_epi8(m) == 0xFFFF)
+#endif
+
+//=============================================================================
+
+//---------------------------
+// Nearest
+//---------------------------
+
+//Each row is widened once, then copied to the other rows it covers
+#define NEAREST(PIXEL)												\
+{																	\
+	const PIXEL* in = (const PIXEL*)(job.src + (y * job.srcPitch));	\
+	PIXEL* out = (PIXEL*)(job.dst + (y * job.scale * job.dstPitch));	\
+	int x, i;														\
+																	\
+	for (x = 0; x < SCREEN_WIDTH; x++)								\
+		for (i = 0; i < job.scale; i++)								\
+			*(out++) = in[x];										\
+}
+
+#ifdef FILTER_SIMD
+
+//Zipping a vector with itself doubles each pixel, so the power of two
+//scales are done by zipping again until the vector is wide enough
+#define WIDEN(PIXEL)												\
+{																	\
+	const PIXEL* in = (const PIXEL*)(job.src + (y * job.srcPitch));	\
+	PIXEL* out = (PIXEL*)(job.dst + (y * job.scale * job.dstPitch));	\
+	const int lanes = 16 / sizeof(PIXEL);							\
+	int x, i, n;													\
+																	\
+	for (x = 0; x < SCREEN_WIDTH; x += lanes)						\
+	{																\
+		VEC v[MAX_SCALE];											\
+																	\
+		v[0] = VLOAD(in + x);										\
+		for (n = 1; n < job.scale; n *= 2)							\
+			for (i = n - 1; i >= 0; i--)							\
+				VZIP##PIXEL(v[i], v[i], v[2 * i], v[(2 * i) + 1]);	\
+																	\
+		for (i = 0; i < job.scale; i++)								\
+			VSTORE(out + ((x * job.scale) + (i * lanes)), v[i]);	\
+	}																\
+}
+
+#endif
+
+static void nearest(int y)
+{
+	_u8* row = job.dst + (y * job.scale * job.dstPitch);
+	int i;
+
+#ifdef FILTER_SIMD
+	if ((job.scale & (job.scale - 1)) == 0 && job.scale > 1)
+	{
+		if (job.bpp == 4)	WIDEN(_u32)
+		else				WIDEN(_u16)
+	}
+	else
+#endif
+	if (job.bpp == 4)	NEAREST(_u32)
+	else				NEAREST(_u16)
+
+	for (i = 1; i < job.scale; i++)
+		memcpy(row + (i * job.dstPitch), row, SCREEN_WIDTH * job.scale * job.bpp);
+}
+
+//=============================================================================
+
+//---------------------------
+// Scale2x / Scale3x
+//---------------------------
+
+//	A B C
+//	D E F	E is scaled by its neighbours, the frame edges repeat
+//	G H I
+
+#ifdef FILTER_SIMD
+#define COLUMN_STEP	(SCREEN_WIDTH - 1)	//Only the edges, the rest is vectors
+#else
+#define COLUMN_STEP	1
+#endif
+
+#define NEIGHBOURS(PIXEL)											\
+	const PIXEL* up = (const PIXEL*)(job.src + (max(y - 1, 0) * job.srcPitch));	\
+	const PIXEL* in = (const PIXEL*)(job.src + (y * job.srcPitch));	\
+	const PIXEL* down = (const PIXEL*)(job.src + 					\
+		(min(y + 1, SCREEN_HEIGHT - 1) * job.srcPitch));			\
+	int x;															\
+																	\
+	for (x = 0; x < SCREEN_WIDTH; x += COLUMN_STEP)					\
+	{																\
+		int l = max(x - 1, 0), r = min(x + 1, SCREEN_WIDTH - 1);	\
+		PIXEL A = up[l], B = up[x], C = up[r];						\
+		PIXEL D = in[l], E = in[x], F = in[r];						\
+		PIXEL G = down[l], H = down[x], I = down[r];
+
+#define SCALE2X(PIXEL)												\
+{																	\
+	PIXEL* row0 = (PIXEL*)(job.dst + (y * 2 * job.dstPitch));		\
+	PIXEL* row1 = (PIXEL*)((_u8*)row0 + job.dstPitch);				\
+	NEIGHBOURS(PIXEL)												\
+		PIXEL* out0 = row0 + (x * 2);								\
+		PIXEL* out1 = row1 + (x * 2);								\
+		(void)A; (void)C; (void)G; (void)I;							\
+																	\
+		if (B != H && D != F)										\
+		{															\
+			out0[0] = (D == B) ? D : E;								\
+			out0[1] = (B == F) ? F : E;								\
+			out1[0] = (D == H) ? D : E;								\
+			out1[1] = (H == F) ? F : E;								\
+		}															\
+		else														\
+			out0[0] = out0[1] = out1[0] = out1[1] = E;				\
+	}																\
+	SCALE2X_SIMD(PIXEL)												\
+}
+
+#define SCALE3X(PIXEL)												\
+{																	\
+	PIXEL* row0 = (PIXEL*)(job.dst + (y * 3 * job.dstPitch));		\
+	PIXEL* row1 = (PIXEL*)((_u8*)row0 + job.dstPitch);				\
+	PIXEL* row2 = (PIXEL*)((_u8*)row1 + job.dstPitch);				\
+	NEIGHBOURS(PIXEL)												\
+		PIXEL* out0 = row0 + (x * 3);								\
+		PIXEL* out1 = row1 + (x * 3);								\
+		PIXEL* out2 = row2 + (x * 3);								\
+																	\
+		if (B != H && D != F)										\
+		{															\
+			out0[0] = (D == B) ? D : E;								\
+			out0[1] = ((D == B && E != C) || (B == F && E != A)) ? B : E;	\
+			out0[2] = (B == F) ? F : E;								\
+			out1[0] = ((D == B && E != G) || (D == H && E != A)) ? D : E;	\
+			out1[1] = E;											\
+			out1[2] = ((B == F && E != I) || (H == F && E != C)) ? F : E;	\
+			out2[0] = (D == H) ? D : E;								\
+			out2[1] = ((D == H && E != I) || (H == F && E != G)) ? H : E;	\
+			out2[2] = (H == F) ? F : E;								\
+		}															\
+		else														\
+		{															\
+			out0[0] = out0[1] = out0[2] = E;						\
+			out1[0] = out1[1] = out1[2] = E;						\
+			out2[0] = out2[1] = out2[2] = E;						\
+		}															\
+	}																\
+	SCALE3X_SIMD(PIXEL)												\
+}
+
+#ifdef FILTER_SIMD
+
+//The inner columns, a vector at a time. The last vector is moved back
+//to end at the last inner column and redoes a few pixels.
+#define VNEIGHBOURS(PIXEL)											\
+{																	\
+	const int lanes = 16 / sizeof(PIXEL);							\
+																	\
+	for (x = 1; x < SCREEN_WIDTH - 1; x += lanes)					\
+	{																\
+		int cx = min(x, SCREEN_WIDTH - 1 - lanes);					\
+		VEC A = VLOAD(up + cx - 1), B = VLOAD(up + cx), C = VLOAD(up + cx + 1);	\
+		VEC D = VLOAD(in + cx - 1), E = VLOAD(in + cx), F = VLOAD(in + cx + 1);	\
+		VEC G = VLOAD(down + cx - 1), H = VLOAD(down + cx);			\
+		VEC I = VLOAD(down + cx + 1);								\
+		VEC same = VOR(VEQ##PIXEL(B, H), VEQ##PIXEL(D, F));			\
+		VEC DB = VEQ##PIXEL(D, B), BF = VEQ##PIXEL(B, F);			\
+		VEC DH = VEQ##PIXEL(D, H), HF = VEQ##PIXEL(H, F);
+
+#define SCALE2X_SIMD(PIXEL)											\
+	VNEIGHBOURS(PIXEL)												\
+		VEC e0, e1, lo, hi;											\
+		(void)A; (void)C; (void)G; (void)I;							\
+																	\
+		e0 = VSEL(VANDNOT(same, DB), D, E);							\
+		e1 = VSEL(VANDNOT(same, BF), F, E);							\
+		VZIP##PIXEL(e0, e1, lo, hi);								\
+		VSTORE(row0 + (cx * 2), lo);	VSTORE(row0 + (cx * 2) + lanes, hi);	\
+																	\
+		e0 = VSEL(VANDNOT(same, DH), D, E);							\
+		e1 = VSEL(VANDNOT(same, HF), F, E);							\
+		VZIP##PIXEL(e0, e1, lo, hi);								\
+		VSTORE(row1 + (cx * 2), lo);	VSTORE(row1 + (cx * 2) + lanes, hi);	\
+	}																\
+}
+
+//There is no three way zip, so the rows are spread out from a buffer
+#define SCALE3X_SIMD(PIXEL)											\
+	VNEIGHBOURS(PIXEL)												\
+		VEC EA = VEQ##PIXEL(E, A), EC = VEQ##PIXEL(E, C);			\
+		VEC EG = VEQ##PIXEL(E, G), EI = VEQ##PIXEL(E, I);			\
+		VEC top = VOR(VANDNOT(EC, DB), VANDNOT(EA, BF));			\
+		VEC left = VOR(VANDNOT(EG, DB), VANDNOT(EA, DH));			\
+		VEC right = VOR(VANDNOT(EI, BF), VANDNOT(EC, HF));			\
+		VEC bottom = VOR(VANDNOT(EI, DH), VANDNOT(EG, HF));			\
+		PIXEL block[3][3][16 / sizeof(PIXEL)];						\
+		int i, j;													\
+																	\
+		VSTORE(block[0][0], VSEL(VANDNOT(same, DB), D, E));			\
+		VSTORE(block[0][1], VSEL(VANDNOT(same, top), B, E));		\
+		VSTORE(block[0][2], VSEL(VANDNOT(same, BF), F, E));			\
+		VSTORE(block[1][0], VSEL(VANDNOT(same, left), D, E));		\
+		VSTORE(block[1][1], E);										\
+		VSTORE(block[1][2], VSEL(VANDNOT(same, right), F, E));		\
+		VSTORE(block[2][0], VSEL(VANDNOT(same, DH), D, E));			\
+		VSTORE(block[2][1], VSEL(VANDNOT(same, bottom), H, E));		\
+		VSTORE(block[2][2], VSEL(VANDNOT(same, HF), F, E));			\
+																	\
+		for (i = 0; i < lanes; i++)									\
+			for (j = 0; j < 3; j++)									\
+			{														\
+				row0[((cx + i) * 3) + j] = block[0][j][i];			\
+				row1[((cx + i) * 3) + j] = block[1][j][i];			\
+				row2[((cx + i) * 3) + j] = block[2][j][i];			\
+			}														\
+	}																\
+}
+
+#else
+#define SCALE2X_SIMD(PIXEL)
+#define SCALE3X_SIMD(PIXEL)
+#endif
+
+static void scale2x(int y)
+{
+	if (job.bpp == 4)	SCALE2X(_u32)
+	else				SCALE2X(_u16)
+}
+
+static void scale3x(int y)
+{
+	if (job.bpp == 4)	SCALE3X(_u32)
+	else				SCALE3X(_u16)
+}
+
+//=============================================================================
+
+//---------------------------
+// xBR (2x)
+//---------------------------
+
+static __inline _u32 pack(_u32 data)
+{
+	_u32 r = (data >> 16) & 0xFF, g = (data >> 8) & 0xFF, b = data & 0xFF;
+
+	switch (cfb_format)
+	{
+	default:
+	case CFB_X4B4G4R4:
+		return ((b >> 4) << 8) | ((g >> 4) << 4) | (r >> 4);
+
+	case CFB_R5G6B5:
+		return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+
+	case CFB_X1R5G5B5:
+		return 0x8000 | ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3);
+
+	case CFB_X8R8G8B8:
+		return data;
+	}
+}
+
+//Y, U and V in 10 bits each, offset so the differences stay positive
+static __inline _u32 toYUV(_u32 data)
+{
+	int r = (data >> 16) & 0xFF, g = (data >> 8) & 0xFF, b = data & 0xFF;
+	int y = (r * 77 + g * 150 + b * 29) >> 8;
+
+	return (y << 20) | ((b - y + 512) << 10) | (r - y + 512);
+}
+
+static __inline int dist(_u32 a, _u32 b)
+{
+	int y = (int)(a >> 20) - (int)(b >> 20);
+	int u = (int)((a >> 10) & 0x3FF) - (int)((b >> 10) & 0x3FF);
+	int v = (int)(a & 0x3FF) - (int)(b & 0x3FF);
+
+	return 48 * abs(y) + 7 * abs(u) + 6 * abs(v);
+}
+
+//Converts the whole frame, before it is split into bands
+static void xbrPrepare(void)
+{
+	int y, x;
+
+	for (y = -2; y < SCREEN_HEIGHT + 2; y++)
+	{
+		const _u8* in = job.src + (max(0, min(y, SCREEN_HEIGHT - 1)) * job.srcPitch);
+
+		for (x = -2; x < SCREEN_WIDTH + 2; x++)
+		{
+			int sx = max(0, min(x, SCREEN_WIDTH - 1));
+			_u32 data = gfx_unpack(cfb_format, (job.bpp == 4) ? ((const _u32*)in)[sx] : 
+				((const _u16*)in)[sx]);
+
+			rgb[y + 2][x + 2] = data;
+			yuv[y + 2][x + 2] = toYUV(data);
+		}
+	}
+}
+
+//The corner of E towards I is blended half way to F or H when the edge
+//between H and F is stronger than the one between E and I:
+//
+//	   A	B	C
+//	D	E	F	F4
+//	G	H	I	I4
+//	   G5	H5	I5
+//
+//The formula is symmetric about the E-I diagonal, so the other corners
+//are the same with the offsets mirrored by 'sx' and 'sy'.
+static __inline _u32 corner(int cx, int cy, int sx, int sy)
+{
+	#define YUV(x, y)	yuv[cy + ((y) * sy)][cx + ((x) * sx)]
+	#define RGB(x, y)	rgb[cy + ((y) * sy)][cx + ((x) * sx)]
+
+	_u32 E = YUV(0, 0);
+	int e = dist(E, YUV(1, -1)) + dist(E, YUV(-1, 1)) + 
+		dist(YUV(1, 1), YUV(2, 0)) + dist(YUV(1, 1), YUV(0, 2)) + 
+		4 * dist(YUV(0, 1), YUV(1, 0));
+	int i = dist(YUV(0, 1), YUV(-1, 0)) + dist(YUV(0, 1), YUV(1, 2)) + 
+		dist(YUV(1, 0), YUV(2, 1)) + dist(YUV(1, 0), YUV(0, -1)) + 
+		4 * dist(E, YUV(1, 1));
+
+	if (e < i)
+	{
+		_u32 a = RGB(0, 0);
+		_u32 b = (dist(E, YUV(1, 0)) <= dist(E, YUV(0, 1))) ? 
+			RGB(1, 0) : RGB(0, 1);
+
+		return ((a & 0xFEFEFEFE) >> 1) + ((b & 0xFEFEFEFE) >> 1);
+	}
+
+	return RGB(0, 0);
+
+	#undef YUV
+	#undef RGB
+}
+
+#define XBR(PIXEL)													\
+{																	\
+	PIXEL* out0 = (PIXEL*)(job.dst + (y * 2 * job.dstPitch));		\
+	PIXEL* out1 = (PIXEL*)((_u8*)out0 + job.dstPitch);				\
+	int x;															\
+																	\
+	for (x = 0; x < SCREEN_WIDTH; x++)								\
+	{																\
+		_u32* E = &rgb[y + 2][x + 2];								\
+																	\
+		/*A corner only ever blends towards F or H, so flat areas*/	\
+		/*keep E everywhere*/										\
+		if (E[-1] == *E && E[1] == *E && E[-XW] == *E && E[XW] == *E)	\
+		{															\
+			PIXEL data = (PIXEL)pack(*E);							\
+			*(out0++) = data;	*(out0++) = data;					\
+			*(out1++) = data;	*(out1++) = data;					\
+			continue;												\
+		}															\
+																	\
+		*(out0++) = (PIXEL)pack(corner(x + 2, y + 2, -1, -1));		\
+		*(out0++) = (PIXEL)pack(corner(x + 2, y + 2, 1, -1));		\
+		*(out1++) = (PIXEL)pack(corner(x + 2, y + 2, -1, 1));		\
+		*(out1++) = (PIXEL)pack(corner(x + 2, y + 2, 1, 1));		\
+	}																\
+}
+
+#ifdef FILTER_SIMD
+
+static __inline VEC vdist(VEC a, VEC b)
+{
+	VEC mask = VSET32(0x3FF);
+	VEC y = VABD32(VSHR32(a, 20), VSHR32(b, 20));
+	VEC u = VABD32(VAND(VSHR32(a, 10), mask), VAND(VSHR32(b, 10), mask));
+	VEC v = VABD32(VAND(a, mask), VAND(b, mask));
+
+	//48y + 7u + 6v
+	return VADD32(VADD32(VADD32(VSHL32(y, 5), VSHL32(y, 4)), VSUB32(VSHL32(u, 3), u)), 
+		VADD32(VSHL32(v, 2), VSHL32(v, 1)));
+}
+
+//corner() for the 4 pixels from column 'cx'
+static __inline VEC vcorner(int cx, int cy, int sx, int sy)
+{
+	#define YUV(x, y)	VLOAD(&yuv[cy + ((y) * sy)][cx + ((x) * sx)])
+	#define RGB(x, y)	VLOAD(&rgb[cy + ((y) * sy)][cx + ((x) * sx)])
+
+	VEC E = YUV(0, 0), F = YUV(1, 0), H = YUV(0, 1), I = YUV(1, 1);
+	VEC e = VADD32(VADD32(vdist(E, YUV(1, -1)), vdist(E, YUV(-1, 1))), 
+		VADD32(VADD32(vdist(I, YUV(2, 0)), vdist(I, YUV(0, 2))), VSHL32(vdist(H, F), 2)));
+	VEC i = VADD32(VADD32(vdist(H, YUV(-1, 0)), vdist(H, YUV(1, 2))), 
+		VADD32(VADD32(vdist(F, YUV(2, 1)), vdist(F, YUV(0, -1))), VSHL32(vdist(E, I), 2)));
+	VEC a = RGB(0, 0);
+	VEC b = VSEL(VLT32(vdist(E, H), vdist(E, F)), RGB(0, 1), RGB(1, 0));
+	VEC half = VSET32(0xFEFEFEFE);
+
+	return VSEL(VLT32(e, i), VADD32(VSHR32(VAND(a, half), 1), VSHR32(VAND(b, half), 1)), a);
+
+	#undef YUV
+	#undef RGB
+}
+
+//The 32-bit output is already X8R8G8B8 and is zipped into place, the
+//16-bit formats are packed a pixel at a time
+static void vxbr(int y)
+{
+	_u8* row0 = job.dst + (y * 2 * job.dstPitch);
+	_u8* row1 = row0 + job.dstPitch;
+	int x, i, j;
+
+	for (x = 0; x < SCREEN_WIDTH; x += 4)
+	{
+		_u32* E = &rgb[y + 2][x + 2];
+		VEC c = VLOAD(E);
+		VEC flat = VAND(VAND(VEQ_u32(VLOAD(E - 1), c), VEQ_u32(VLOAD(E + 1), c)), 
+			VAND(VEQ_u32(VLOAD(E - XW), c), VEQ_u32(VLOAD(E + XW), c)));
+		VEC corners[4], lo, hi;
+		_u32 block[4][4];
+
+		//As XBR(), a pixel with the same colour on all four sides keeps it
+		if (VALL(flat))
+		{
+			corners[0] = corners[1] = corners[2] = corners[3] = c;
+		}
+		else
+		{
+			corners[0] = VSEL(flat, c, vcorner(x + 2, y + 2, -1, -1));
+			corners[1] = VSEL(flat, c, vcorner(x + 2, y + 2, 1, -1));
+			corners[2] = VSEL(flat, c, vcorner(x + 2, y + 2, -1, 1));
+			corners[3] = VSEL(flat, c, vcorner(x + 2, y + 2, 1, 1));
+		}
+
+		if (job.bpp == 4)
+		{
+			VZIP_u32(corners[0], corners[1], lo, hi);
+			VSTORE((_u32*)row0 + (x * 2), lo);	VSTORE((_u32*)row0 + (x * 2) + 4, hi);
+			VZIP_u32(corners[2], corners[3], lo, hi);
+			VSTORE((_u32*)row1 + (x * 2), lo);	VSTORE((_u32*)row1 + (x * 2) + 4, hi);
+			continue;
+		}
+
+		for (j = 0; j < 4; j++)
+			VSTORE(block[j], corners[j]);
+
+		for (i = 0; i < 4; i++)
+		{
+			_u16* out0 = (_u16*)row0 + ((x + i) * 2);
+			_u16* out1 = (_u16*)row1 + ((x + i) * 2);
+
+			out0[0] = (_u16)pack(block[0][i]);	out0[1] = (_u16)pack(block[1][i]);
+			out1[0] = (_u16)pack(block[2][i]);	out1[1] = (_u16)pack(block[3][i]);
+		}
+	}
+}
+
+#endif
+
+static void xbr(int y)
+{
+#ifdef FILTER_SIMD
+	vxbr(y);
+#else
+	if (job.bpp == 4)	XBR(_u32)
+	else				XBR(_u16)
+#endif
+}
+
+//=============================================================================
+
+static void filterBand(int index)
+{
+	int y, last = (SCREEN_HEIGHT * (index + 1)) / threads;
+
+	for (y = (SCREEN_HEIGHT * index) / threads; y < last; y++)
+	{
+		switch (job.filter)
+		{
+		default:
+		case FILTER_NEAREST:	nearest(y);	break;
+		case FILTER_SCALE2X:	scale2x(y);	break;
+		case FILTER_SCALE3X:	scale3x(y);	break;
+		case FILTER_XBR:		xbr(y);		break;
+		}
+	}
+}
+
+static void filter_thread(void* param)
+{
+	int index = *(int*)param;
+
+	while(1)
+	{
+		system_sem_wait(semStart[index]);
+		if (quit)
+			break;
+
+		filterBand(index);
+		system_sem_post(semDone);
+	}
+
+	system_sem_post(semDone);
+}
+
+//=============================================================================
+
+int gfx_filter_scale(FILTER filter, int scale)
+{
+	switch (filter)
+	{
+	default:
+	case FILTER_NEAREST:	return max(1, min(scale, MAX_SCALE));
+	case FILTER_SCALE2X:	return 2;
+	case FILTER_SCALE3X:	return 3;
+	case FILTER_XBR:		return 2;
+	}
+}
+
+void gfx_filter(FILTER filter, int scale, const void* src, int src_pitch, 
+				void* dst, int dst_pitch)
+{
+	int i;
+
+	job.filter = filter;
+	job.scale = gfx_filter_scale(filter, scale);
+	job.bpp = CFB_PIXEL_SIZE(cfb_format);
+	job.src = (const _u8*)src;
+	job.srcPitch = src_pitch;
+	job.dst = (_u8*)dst;
+	job.dstPitch = dst_pitch;
+
+	if (filter == FILTER_XBR)
+		xbrPrepare();
+
+	for (i = 1; i < threads; i++)
+		system_sem_post(semStart[i]);
+
+	filterBand(0);
+
+	for (i = 1; i < threads; i++)
+		system_sem_wait(semDone);
+}
+
+BOOL gfx_filter_start(int count)
+{
+	gfx_filter_stop();
+	count = max(1, min(count, MAX_THREADS));
+
+	if (count > 1 && (semDone = system_sem_create(0)) == NULL)
+		return FALSE;
+
+	while (threads < count)
+	{
+		band[threads] = threads;
+
+		if ((semStart[threads] = system_sem_create(0)) == NULL)
+			break;
+
+		if (!system_thread_start(filter_thread, &band[threads]))
+		{
+			system_sem_destroy(semStart[threads]);
+			break;
+		}
+
+		threads++;
+	}
+
+	if (threads < count)
+	{
+		gfx_filter_stop();
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void gfx_filter_stop(void)
+{
+	int i;
+
+	if (threads == 1)
+	{
+		if (semDone) system_sem_destroy(semDone);
+		semDone = NULL;
+		return;
+	}
+
+	quit = TRUE;
+	for (i = 1; i < threads; i++)
+	{
+		system_sem_post(semStart[i]);
+		system_sem_wait(semDone);
+		system_sem_destroy(semStart[i]);
+	}
+	quit = FALSE;
+
+	system_sem_destroy(semDone);
+	semDone = NULL;
+	threads = 1;
+}
+
+//=============================================================================
+
+void gfx_filter_benchmark(int frames)
+{
+	static const char* names[] = { "Nearest x4", "Scale2x", "Scale3x", "xBR" };
+	int bpp = CFB_PIXEL_SIZE(cfb_format);
+	int pitch = SCREEN_WIDTH * 4 * bpp;
+	_u8* out = (_u8*)malloc(pitch * SCREEN_HEIGHT * 4);
+	int filter, i;
+
+	if (out == NULL)
+		return;
+
+	for (filter = FILTER_NEAREST; filter <= FILTER_XBR; filter++)
+	{
+		int scale = gfx_filter_scale((FILTER)filter, 4);
+		_u32 start = system_get_time(), elapsed;
+		double pixels;
+
+		for (i = 0; i < frames; i++)
+			gfx_filter((FILTER)filter, 4, cfb, cfb_pitch, out, pitch);
+
+		elapsed = max(system_get_time() - start, 1);
+		pixels = (double)frames * SCREEN_WIDTH * SCREEN_HEIGHT * scale * scale;
+
+		system_message("%s: %.1f megapixels per second, %d threads", 
+			names[filter], pixels / elapsed, threads);
+	}
+
+	free(out);
+}
+
+//=============================================================================
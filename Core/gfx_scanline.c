@@ -0,0 +1,479 @@
+//---------------------------------------------------------------------------
+// NEOPOP : Emulator as in Dreamland
+//
+// Copyright (c) 2001-2002 by neopop_uk
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+//	This program is free software; you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version. See also the license.txt file for
+//	additional informations.
+//---------------------------------------------------------------------------
+
+/*
+//---------------------------------------------------------------------------
+//=========================================================================
+
+	gfx_scanline.c
+
+//=========================================================================
+//---------------------------------------------------------------------------
+
+  History of changes:
+  ===================
+
+  Merged from gfx_scanline_colour.c and gfx_scanline_mono.c, the mode
+  differences are now in the MODE table below. Their histories follow,
+  entries marked (mono) or (colour) applied to one only.
+
+11 SEP 2007 - Akop Karapetyan
+=======================================
+- ORing every pixel with 0xF000 (normally unused, for PSP specifies
+  an opaque pixel)
+
+06 JUL 2006 - PSmonkey
+=======================================
+- Optimised Rendering
+- Added fixed conversion table from 3bit to 16bit (mono)
+
+05 JUL 2006 - PSmonkey
+=======================================
+- Changed cfb offset to scanline * 256
+
+20 JUL 2002 - neopop_uk
+=======================================
+- Cleaned and tidied up for the source release
+
+22 JUL 2002 - neopop_uk
+=======================================
+- Removed delayed settings retrieval, this is now done by 'interrupt.c'
+- Removed hack for scanline 0!
+- Fixed palettes (mono)
+- Inverted all colours (1's complement) to make correct LCD emulation (mono)
+
+24 JUL 2002 - neopop_uk
+=======================================
+- Added Negative/Positive colour switching
+
+25 JUL 2002 - neopop_uk
+=======================================
+- Fixed a stupid bug in the dimensions of the
+	right side of the hardware window.
+
+01 AUG 2002 - neopop_uk
+=======================================
+- Forced the background colour to be on - always. (colour)
+
+06 AUG 2002 - neopop_uk
+=======================================
+- Switched to 16-bit [0BGR] rendering, should be much faster.
+
+15 AUG 2002 - neopop_uk
+=======================================
+- Changed parameter 4 of drawPattern from bool to _u16, for performance
+	and compatiblity reasons.
+- Changed parameter 3 of Plot (pal_hi) from bool to _u16, and in turn
+	parameter 6 of drawPattern - again for performance and compatiblity.
+	(mono)
+
+16 AUG 2002 - neopop_uk
+=======================================
+- Optimised things a little by removing some extraneous pointer work
+	and shifting.
+
+//---------------------------------------------------------------------------
+*/
+
+#include "neopop.h"
+#include "mem.h"
+#include "gfx.h"
+
+//=============================================================================
+
+//Line buffer entries are indices into the colour palette RAM at 0x8200,
+//the mono palettes at 0x8100 and their shades are resolved to the same.
+#define PAL_SPRITE		0x00
+#define PAL_SCROLL1		0x40
+#define PAL_SCROLL2		0x80
+#define PAL_BACKGROUND	0xF0
+#define PAL_WINDOW		0xF8
+
+static _u16 uConvert3bTo16b[8] = {
+	0x0000, 0x0222, 0x0444, 0x0666, 0x0888, 0x0AAA, 0x0CCC, 0x0EEE,
+};
+
+//=============================================================================
+
+//Where the mono (K1GE) and colour (K2GE) modes differ
+typedef struct
+{
+	void (*buildPalette)(GFX_RENDERER* r);
+
+	//Palette of a map or sprite entry: (entry >> shift) & mask
+	_u8 shift, mask;
+
+	BOOL spriteTable;		//Sprite palettes from 0x8C00 instead
+	BOOL background;		//Background always on, HACK: 01 AUG 2002
+}
+MODE;
+
+//=============================================================================
+
+static __inline void Plot(GFX_RENDERER* r, _u8 x, _u8 palette, _u8 index, 
+						  _u8 depth)
+{
+	// Index & Depth check, <= to stop later sprites overwriting pixels!
+	if( ( index == 0 ) || ( depth <= r->zbuffer[x] ) )
+		return;
+
+	r->zbuffer[x] = depth;
+	r->ibuffer[x] = palette + index;
+}
+
+//'data' holds the colour index in bits 0 - 1, and the palette in
+//((data >> shift) & mask) added to 'base'
+static __inline void plotData(GFX_RENDERER* r, _u8 x, _u8 data, _u8 shift, 
+							  _u8 mask, _u8 base, _u8 depth)
+{
+	Plot(r, x, base + ((data >> shift) & mask), data & 3, depth);
+}
+
+//plotData() for 8 pixels from 'x' at once, with masked compares. The
+//palette bits (mask << shift) fit in a byte for both modes, so they can
+//be masked before shifting the whole vector.
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+#define PLOT_ROW
+
+static __inline void plotRow(GFX_RENDERER* r, _u8 x, const _u8* data, 
+							 _u8 shift, _u8 mask, _u8 base, _u8 depth)
+{
+	__m128i in = _mm_loadl_epi64((const __m128i*)data);
+	__m128i z = _mm_loadl_epi64((const __m128i*)(r->zbuffer + x));
+	__m128i entry = _mm_loadl_epi64((const __m128i*)(r->ibuffer + x));
+	__m128i level = _mm_set1_epi8((char)depth);
+	__m128i index = _mm_and_si128(in, _mm_set1_epi8(3));
+	__m128i palette = _mm_srl_epi16(_mm_and_si128(in, 
+		_mm_set1_epi8((char)(mask << shift))), _mm_cvtsi32_si128(shift));
+	__m128i hidden;
+
+	//Transparent, or not in front (depth <= z)
+	hidden = _mm_or_si128(_mm_cmpeq_epi8(index, _mm_setzero_si128()), 
+		_mm_cmpeq_epi8(_mm_max_epu8(z, level), z));
+
+	z = _mm_or_si128(_mm_and_si128(hidden, z), _mm_andnot_si128(hidden, level));
+	palette = _mm_add_epi8(_mm_set1_epi8((char)base), _mm_add_epi8(palette, index));
+	entry = _mm_or_si128(_mm_and_si128(hidden, entry), _mm_andnot_si128(hidden, palette));
+
+	_mm_storel_epi64((__m128i*)(r->zbuffer + x), z);
+	_mm_storel_epi64((__m128i*)(r->ibuffer + x), entry);
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+#define PLOT_ROW
+
+static __inline void plotRow(GFX_RENDERER* r, _u8 x, const _u8* data, 
+							 _u8 shift, _u8 mask, _u8 base, _u8 depth)
+{
+	uint8x8_t in = vld1_u8(data);
+	uint8x8_t z = vld1_u8(r->zbuffer + x);
+	uint8x8_t entry = vld1_u8(r->ibuffer + x);
+	uint8x8_t level = vdup_n_u8(depth);
+	uint8x8_t index = vand_u8(in, vdup_n_u8(3));
+	uint8x8_t palette = vshl_u8(vand_u8(in, vdup_n_u8((_u8)(mask << shift))), 
+		vdup_n_s8(-(int)shift));
+	uint8x8_t shown;
+
+	//Opaque, and in front (depth > z)
+	shown = vand_u8(vtst_u8(index, index), vcgt_u8(level, z));
+
+	palette = vadd_u8(vdup_n_u8(base), vadd_u8(palette, index));
+	vst1_u8(r->zbuffer + x, vbsl_u8(shown, level, z));
+	vst1_u8(r->ibuffer + x, vbsl_u8(shown, palette, entry));
+}
+
+#endif
+
+static void drawPattern(GFX_RENDERER* r, _u8 screenx, _u16 tile, _u8 tiley, 
+				 _u16 mirror, _u8 palette, _u8 depth)
+{
+	//Get the decoded "tiley'th" line of "tile", already flipped if needed.
+	_u8* pixel = gfx_tile_row(r, tile, tiley, mirror);
+
+#ifdef PLOT_ROW
+	//Unless it wraps round the line buffers
+	if (screenx <= 256 - 8)
+	{
+		plotRow(r, screenx, pixel, 0, 0, palette, depth);
+		return;
+	}
+#endif
+
+	Plot(r, screenx + 0, palette, pixel[0], depth);
+	Plot(r, screenx + 1, palette, pixel[1], depth);
+	Plot(r, screenx + 2, palette, pixel[2], depth);
+	Plot(r, screenx + 3, palette, pixel[3], depth);
+	Plot(r, screenx + 4, palette, pixel[4], depth);
+	Plot(r, screenx + 5, palette, pixel[5], depth);
+	Plot(r, screenx + 6, palette, pixel[6], depth);
+	Plot(r, screenx + 7, palette, pixel[7], depth);
+}
+
+//Resolve the palette RAM to output colours
+static void buildColour(GFX_RENDERER* r)
+{
+	const GFX_LINE* line = r->line;
+	_u16* palette;
+	int i;
+
+	//The palette RAM spans two pages, either may have been copied
+	palette = (_u16*)VRAM(line, 0x8200);
+	for (i = 0; i < 0x80; i++)
+		r->palette[i] = gfx_convert(line->format, 
+			((line->negative) ? ~palette[i] : palette[i]) | 0xF000);
+
+	palette = (_u16*)VRAM(line, 0x8300);
+	for (i = 0; i < 0x80; i++)
+		r->palette[0x80 + i] = gfx_convert(line->format, 
+			((line->negative) ? ~palette[i] : palette[i]) | 0xF000);
+}
+
+static __inline _u16 shade(_u8 negative, _u8 data8)
+{
+	return ((negative) 
+		? uConvert3bTo16b[data8 & 7]
+		: ~uConvert3bTo16b[data8 & 7]) | 0xF000;
+}
+
+//Resolve the two palettes of each kind to their shades, and the shades
+//of the window and background registers
+static void buildMono(GFX_RENDERER* r)
+{
+	const GFX_LINE* line = r->line;
+	_u8* palette = VRAM(line, 0x8100);
+	int x;
+
+	for (x = 0; x < 8; x++)
+	{
+		r->palette[PAL_SPRITE + x] = gfx_convert(line->format, 
+			shade(line->negative, palette[x]));
+		r->palette[PAL_SCROLL1 + x] = gfx_convert(line->format, 
+			shade(line->negative, palette[8 + x]));
+		r->palette[PAL_SCROLL2 + x] = gfx_convert(line->format, 
+			shade(line->negative, palette[16 + x]));
+		r->palette[PAL_BACKGROUND + x] = r->palette[PAL_WINDOW + x] = 
+			gfx_convert(line->format, shade(line->negative, x));
+	}
+}
+
+static const MODE modes[2] =
+{
+	{ buildMono, 11, 0x04, FALSE, FALSE },		//Bit 13
+	{ buildColour, 7, 0x3C, TRUE, TRUE },		//Bits 9 - 12
+};
+
+//=============================================================================
+
+//Draw the current line of a scroll plane, only inside the window
+static void drawScroll(GFX_RENDERER* r, const MODE* mode, _u16 map, 
+					   _u8 scrollx, _u8 scrolly, _u8 base, _u8 depth)
+{
+	const GFX_LINE* line = r->line;
+	_u8 row, y, px;
+	_u16 data16;
+	_u16* tiles;
+	_u8* pixel;
+	int x, end;
+
+	y = line->scanline + scrolly;
+	row = y & 7;	//Which row?
+	tiles = (_u16*)VRAM(line, map + ((y >> 3) << 6));
+
+	x = line->winx;
+	end = min(line->winx + line->winw, SCREEN_WIDTH);
+
+	//Copy the span from the decoded plane, which holds bits 9 - 13
+	if (r->planes)
+	{
+		_u8* bitmap = gfx_plane[(map >> 11) & 1][y];
+		_u8 shift = mode->shift - 7;
+
+		while (x < end)
+		{
+			px = x + scrollx;
+
+#ifdef PLOT_ROW
+			//Unless it wraps round the plane
+			if (x + 8 <= end && px <= 256 - 8)
+			{
+				plotRow(r, x, bitmap + px, shift, mode->mask, base, depth);
+				x += 8;
+				continue;
+			}
+#endif
+			plotData(r, x, bitmap[px], shift, mode->mask, base, depth);
+			x++;
+		}
+		return;
+	}
+
+	while (x < end)
+	{
+		px = x + scrollx;	//Position in the plane
+		data16 = tiles[px >> 3];
+
+		//Get the decoded line of the tile
+		pixel = gfx_tile_row(r, data16 & 0x01FF, 
+			(data16 & 0x4000) ? (7 - row) : row, data16 & 0x8000);
+
+#ifdef PLOT_ROW
+		if ((px & 7) == 0 && x + 8 <= end)
+		{
+			plotRow(r, x, pixel, 0, 0, 
+				base + ((data16 >> mode->shift) & mode->mask), depth);
+			x += 8;
+			continue;
+		}
+#endif
+
+		//The first and last tiles may be partly visible
+		for (px &= 7; px < 8 && x < end; px++, x++)
+			Plot(r, x, base + ((data16 >> mode->shift) & mode->mask), 
+				pixel[px], depth);
+	}
+}
+
+static void gfx_draw_scroll1(GFX_RENDERER* r, const MODE* mode, _u8 depth)
+{
+	//Draw Foreground scroll plane (Scroll 1)
+	drawScroll(r, mode, 0x9000, r->line->scroll1x, r->line->scroll1y, 
+		PAL_SCROLL1, depth);
+}
+
+static void gfx_draw_scroll2(GFX_RENDERER* r, const MODE* mode, _u8 depth)
+{
+	//Draw Background scroll plane (Scroll 2)
+	drawScroll(r, mode, 0x9800, r->line->scroll2x, r->line->scroll2y, 
+		PAL_SCROLL2, depth);
+}
+
+void gfx_draw_scanline_mode(GFX_RENDERER* r)
+{
+	const GFX_LINE* line = r->line;
+	const MODE* mode = &modes[line->colour ? 1 : 0];
+	_u8 scanline = line->scanline;
+	int spr, x, i;
+	_u16 data16;
+	_u32* zbuffer32 = (_u32*)r->zbuffer;
+
+	//memset(cfb_scanline, 0, SCREEN_WIDTH * sizeof(_u16));
+	//memset(zbuffer, 0, SCREEN_WIDTH);
+	for( x = 0; x < 40; x+=4 )
+	{
+		zbuffer32[x] = 0;
+		zbuffer32[x+1] = 0;
+		zbuffer32[x+2] = 0;
+		zbuffer32[x+3] = 0;
+	}
+
+	if (!gfx_palette_valid(r, line->colour))
+	{
+		mode->buildPalette(r);
+
+		r->palettes = line->palettes;
+		r->palNegative = line->negative;
+		r->palColour = line->colour;
+		r->palFormat = line->format;
+	}
+
+	//Top
+	if (scanline < line->winy)
+	{
+		// Fill Scanline
+		memset(r->ibuffer, PAL_WINDOW + line->oowc, SCREEN_WIDTH);
+		gfx_resolve(r);
+		// Return. we're done
+		return;
+	}
+	else
+	{
+		//Middle
+		if (scanline < line->winy + line->winh)
+		{
+			for (x = 0; x < min(line->winx, SCREEN_WIDTH); x++)
+			{
+				r->ibuffer[x] = PAL_WINDOW + line->oowc;
+				r->zbuffer[x] = 255;
+			}
+			
+			for (x = min(line->winx + line->winw, SCREEN_WIDTH); x < SCREEN_WIDTH; x++)
+			{
+				r->ibuffer[x] = PAL_WINDOW + line->oowc;
+				r->zbuffer[x] = 255;
+			}
+		}
+		else	//Bottom
+		{
+			// Fill Scanline
+			memset(r->ibuffer, PAL_WINDOW + line->oowc, SCREEN_WIDTH);
+			gfx_resolve(r);
+			// Return. we're done
+			return;
+		}
+	}
+
+	//Ignore above and below the window's top and bottom
+	//if (scanline >= winy && scanline < winy + winh)
+	{
+		//Background colour Enabled?
+		_u8 background = PAL_BACKGROUND;
+		if (mode->background || (line->bgc & 0xC0) == 0x80)
+			background += line->bgc & 7;
+
+		//Draw background!
+		for (x = line->winx; x < min(line->winx + line->winw, SCREEN_WIDTH); x++)	
+			r->ibuffer[x] = background;
+
+		//Swap Front/Back scroll planes?
+		if (line->planeSwap)
+		{
+			gfx_draw_scroll1(r, mode, ZDEPTH_BACKGROUND_SCROLL);		//Swap
+			gfx_draw_scroll2(r, mode, ZDEPTH_FOREGROUND_SCROLL);
+		}
+		else
+		{
+			gfx_draw_scroll2(r, mode, ZDEPTH_BACKGROUND_SCROLL);		//Normal
+			gfx_draw_scroll1(r, mode, ZDEPTH_FOREGROUND_SCROLL);
+		}
+
+		//Draw Sprites, only those listed for this line
+		gfx_sprites(r);
+
+		for (i = 0; i < r->sprite_count[scanline]; i++)
+		{
+			_u8 row, palette;
+
+			spr = r->sprite_list[scanline][i];
+			data16 = *(_u16*)VRAM(line, 0x8800 + (spr * 4));
+
+			if (mode->spriteTable)
+				palette = (*VRAM(line, 0x8C00 + spr) & 0xF) << 2;
+			else
+				palette = (data16 >> mode->shift) & mode->mask;
+
+			row = (scanline - r->sprite_y[spr]) & 7;	//Which row?
+			drawPattern(r, r->sprite_x[spr], data16 & 0x01FF, 
+				(data16 & 0x4000) ? 7 - row : row, data16 & 0x8000,
+				PAL_SPRITE + palette, ((data16 & 0x1800) >> 11) << 1); 
+		}
+	}
+
+	gfx_resolve(r);
+}
+
+//=============================================================================
@@ -89,10 +89,12 @@
 #include "TLCS900h_interpret.h"
 #include "Z80_interface.h"
 #include "dma.h"
+#include "capture.h"
+#include "sound.h"
 
 //=============================================================================
 
-_u32 timer_hint;
+_u32 timer_hint, timer_line;
 _u32 timer_clock0, timer_clock1, timer_clock2, timer_clock3;
 _u8 timer[4];	//Up-counters
 
@@ -143,10 +145,7 @@ static __inline void gfx_draw(void)
 	{
 		//Draw the scanline
 		if (ram[0x8009] < SCREEN_HEIGHT)
-		{
-			if (ram[0x6F95] == 0x10)	gfx_draw_scanline_colour();
-			else						gfx_draw_scanline_mono();
-		}
+			gfx_draw_scanline();
 	}
 }
 
@@ -174,6 +173,7 @@ void updateTimers(_u8 cputicks)
 
 		ram[0x8009]++;	//Next scanline
 		timer_hint = 0;	//Start of next scanline
+		timer_line += TIMER_HINT_RATE;
 
 		//Comms. Read interrupt
 		if ((ram[0xB2] & 1) == 0 && system_comms_poll(&data) && 
@@ -190,18 +190,20 @@ void updateTimers(_u8 cputicks)
 		//V_Int?
 		if (ram[0x8009] == SCREEN_HEIGHT)
 		{
+			gfx_end_frame();	//Finish a deferred frame
+
 			if (frameskip_count == 0)
 				interlace ^= 1;		// Change Scanline
 
 			ram[0x8010] = 0x40;	//Character Over / Vblank Status
+			Z80_sync();			//Catch the z80 up for the frame's sound
+			sound_frame();		//Render the frame's sound
+			capture_frame();	//Record the finished frame
 			system_VBL();	//Update the screen
 
 			//Frameskip
 			frameskip_count = (frameskip_count + 1) % system_frameskip_key;
 
-			ram[0x8010] = 0x40;	//Character Over / Vblank Status
-			system_VBL();	//Update the screen
-
 			//Vertical Interrupt? (Confirmed IRQ Level)
 			if (statusIFF() <= 4 && (ram[0x8000] & 0x80))
 			{
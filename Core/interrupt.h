@@ -75,6 +75,11 @@ void updateTimers(_u8 cputicks);
 
 //H-INT Timer
 extern _u32 timer_hint;
+
+//Ticks at the start of this scanline, counted from power on. Sound chip
+//writes are stamped with the current tick, so they can be played in time.
+extern _u32 timer_line;
+#define TIMER_NOW		(timer_line + min(timer_hint, TIMER_HINT_RATE))
 extern _u8 timer[4];	//Up-counters
 extern _u32 timer_clock0, timer_clock1, timer_clock2, timer_clock3;
 
@@ -147,6 +147,14 @@ void* translate_address_read(_u32 address)
 	if (address == 0x8008)
 		ram[0x8008] = (_u8)((abs(TIMER_HINT_RATE - (int)timer_hint)) >> 2);
 
+	//z80 communication, let the z80 catch up first
+	if ((address & ~7) == 0xB8)
+		Z80_sync();
+
+	//z80 shared RAM
+	if (address >= 0x7000 && address <= 0x7FFF)
+		Z80_join();
+
 	if (address <= RAM_END)
 		return ram + address;
 
@@ -214,6 +222,20 @@ void* translate_address_write(_u32 address)
 
 	// ===================================
 
+	//z80 communication, let the z80 catch up first
+	if ((address & ~7) == 0xB8)
+	{
+		Z80_sync();
+		Z80_wake();
+	}
+
+	//z80 shared RAM
+	if (address >= 0x7000 && address <= 0x7FFF)
+		Z80_wake();
+
+	//Video RAM, keep the renderer's caches and recorded lines valid
+	if (address >= 0x8000 && address <= 0xBFFF)
+		gfx_vram_write(address);
 
 	if (address <= RAM_END)
 		return ram + address;
@@ -299,12 +321,19 @@ void post_write(_u32 address)
 	//Direct Access to Sound Chips
 	if ((*(_u16*)(ram + 0xb8)) == 0xAA55)
 	{
-		if (address == 0xA1)	Write_SoundChipTone(ram[0xA1]);
-		if (address == 0xA0)	Write_SoundChipNoise(ram[0xA0]);
+		//Keep z80 and TLCS-900h writes in order
+		if (address == 0xA0 || address == 0xA1)	Z80_sync();
+
+		if (address == 0xA1)	Write_SoundChipTone(ram[0xA1], TIMER_NOW);
+		if (address == 0xA0)	Write_SoundChipNoise(ram[0xA0], TIMER_NOW);
 	}
 
-	//DAC Write
-	if (address == 0xA2)	dac_write();
+	//DAC Write, left and right. The z80 logs sound writes too, so let it
+	//catch up first to keep the log in order.
+	if (address == 0xA2 || address == 0xA3)	Z80_sync();
+
+	if (address == 0xA2)	dac_write(0, ram[0xA2], TIMER_NOW);
+	if (address == 0xA3)	dac_write(1, ram[0xA3], TIMER_NOW);
 
 	//Clear counters?
 	if (address == 0x20)
@@ -499,7 +528,11 @@ void reset_memory(void)
 	memory_flash_command = FALSE;
 	interlace = 2;
 
+	gfx_render_lines();				//Draw any recorded lines first
 	memset(ram, 0, sizeof(ram));	//Clear ram
+	gfx_tile_flush();
+	gfx_sprite_gen++;
+	gfx_palette_gen++;
 
 //=============================================================================
 //000000 -> 000100	CPU Internal RAM (Timers/DMA/Z80)
@@ -89,15 +89,18 @@ void __cdecl instruction_error(char* vaMessage,...)
 
 void emulate(void)
 {
-	_u8 i;
+	_u8 i, cputicks;
 	
 	//Execute several instructions to boost performance
-	for (i = 0; i < 64; i++)
+	for (i = 0; i < 128; i++)
 	{
-		updateTimers(TLCS900h_interpret());
-		if (Z80ACTIVE) Z80EMULATE
-		updateTimers(TLCS900h_interpret());
+		cputicks = TLCS900h_interpret();
+		Z80CLOCK(cputicks)
+		updateTimers(cputicks);
 	}
+
+	//The z80 runs in bursts, bring it up to date
+	Z80_kick();
 }
 
 #endif
@@ -146,6 +146,10 @@
 #define min(a,b) ((a)<(b)?(a):(b))
 #endif
 
+//Keeps memory accesses from moving across it, for the lock-free rings
+//shared between threads
+#define MEMORY_BARRIER()	__sync_synchronize()
+
 //===========================
 #endif
 
@@ -161,6 +165,9 @@
 	typedef unsigned __int64	_u64;
 	typedef signed __int64		_s64;
 
+#include <intrin.h>
+#define MEMORY_BARRIER()	_ReadWriteBarrier()	//x86 keeps stores in order
+
 //===========================
 #endif
 
@@ -317,8 +324,82 @@ RomHeader;
 #define SCREEN_WIDTH	160
 #define SCREEN_HEIGHT	152
 
-	//16-bit Frame buffer: Format X4B4G4R4
-	extern _u16* cfb; //[256*256];
+	//Frame buffer formats, pixels are opaque where there is alpha
+typedef enum
+{
+	CFB_X4B4G4R4,		//16-bit, the default
+	CFB_R5G6B5,			//16-bit
+	CFB_X1R5G5B5,		//16-bit
+	CFB_X8R8G8B8		//32-bit
+}
+CFB_FORMAT;
+
+#define CFB_PIXEL_SIZE(format)	(((format) == CFB_X8R8G8B8) ? 4 : 2)
+
+	//Frame buffer: SCREEN_HEIGHT lines of SCREEN_WIDTH pixels
+	extern void* cfb;
+	extern CFB_FORMAT cfb_format;	//X4B4G4R4 by default
+	extern int cfb_pitch;			//Bytes per line, 512 by default
+
+	typedef struct
+	{
+		void* base;			//First pixel of the first line
+		int pitch;			//Bytes from one line to the next
+		CFB_FORMAT format;
+		int width, height;	//Pixels, at least SCREEN_WIDTH x SCREEN_HEIGHT
+	}
+	CFB_DESC;
+
+/*! Draws to the buffer described, from its top left corner. A pitch of
+	SCREEN_WIDTH pixels packs the frame into one contiguous block, with
+	nothing but the shown pixels in it. Returns FALSE if the buffer is too
+	small for a frame, the pitch isn't a whole number of pixels, or
+	buffers are set by gfx_frame_buffers. */
+
+	BOOL gfx_frame_buffer(const CFB_DESC* desc);
+
+	//Keep both scroll planes decoded whole, which is faster for games that
+	//scroll mostly static maps. Takes 128KB, off by default.
+	extern BOOL gfx_plane_cache;
+
+/*! Draws frames to 'count' (2 or 3) buffers in turn, each laid out like
+	the one last given to gfx_frame_buffer, instead of always to 'cfb'.
+	When system_VBL is called, 'cfb' points to the newest complete frame,
+	which is left alone until the next system_VBL, so it can be used
+	without a copy. A count of 0 goes back to drawing to 'cfb'. */
+
+	BOOL gfx_frame_buffers(void** buffers, int count);
+
+/*! Returns TRUE if 'cfb' looks different to when system_VBL was last
+	called, so an unchanged frame need not be presented again. A frame
+	is not drawn at all when nothing it is drawn from has changed. */
+
+	BOOL gfx_frame_changed(void);
+
+		//=========================================
+
+	typedef enum
+	{
+		FILTER_NEAREST,		//Whole multiples of the size, up to 8
+		FILTER_SCALE2X,		//Scale2x (x2) and Scale3x (x3) edge rules
+		FILTER_SCALE3X,
+		FILTER_XBR,			//Blended xBR edges (x2)
+	}
+	FILTER;
+
+/*! Scales a frame laid out like 'cfb' (in 'cfb_format') up by the
+	factor returned by gfx_filter_scale, to 'dst' in the same format.
+	'scale' only applies to FILTER_NEAREST. Uses the threads started
+	by gfx_filter_start. */
+
+	void gfx_filter(FILTER filter, int scale, const void* src, int src_pitch,
+					void* dst, int dst_pitch);
+	int gfx_filter_scale(FILTER filter, int scale);
+
+/*! Times each filter over 'frames' frames of 'cfb' and reports the
+	speed of each in megapixels per second, with system_message */
+
+	void gfx_filter_benchmark(int frames);
 
 	extern _u8 interlace;
 
@@ -339,18 +420,36 @@ RomHeader;
 // Core <--> System-Sound Interface
 //-----------------------------------------------------------------------------
 
-	// Speed of DAC playback
-#define DAC_FREQUENCY		8000 //hz
-
 	extern BOOL mute;
 
-/*!	Fills the given buffer with sound data */
+/*!	Fills the given buffer with signed 16-bit sound data, the chips and
+	the DACs mixed together. sound_update_stereo interleaves left and
+	right as the NGP routes them, sound_update averages the two. The
+	sound is rendered by the emulation at each VBL, and queued for this
+	to take from. */
 
 	void sound_update(_u16* chip_buffer, int length_bytes);
 	void sound_update_stereo(_u16* chip_buffer, int length_bytes);
-	void dac_update(_u8* dac_buffer, int length_bytes);
 
-/*! Initialises the sound chips using the given SampleRate */
+/*! For systems without sound output, such as headless runs: takes the
+	stereo samples rendered at the last VBL, at most 'max_samples', and
+	returns how many there were. Call it once per frame with
+	sound_latency set to SOUND_FREE_RUN, so the sound is the same
+	whatever speed the emulation runs at. */
+
+	int sound_update_frame(_u16* chip_buffer, int max_samples);
+
+/*! Samples kept queued for sound_update, a little more than it takes at
+	once. The rendering speeds up or slows down very slightly to keep the
+	queue this full. 0 for a twentieth of a second, SOUND_FREE_RUN to
+	always render at exactly the sample rate. */
+
+	extern int sound_latency;
+
+#define SOUND_FREE_RUN		-1
+
+/*! Initialises the sound chips using the given SampleRate, which can be
+	any rate the system plays at */
 	
 	void sound_init(int SampleRate);
 
@@ -365,6 +464,66 @@ RomHeader;
 	void system_sound_silence(void);
 
 
+//-----------------------------------------------------------------------------
+// Core <--> System-Thread Interface
+//-----------------------------------------------------------------------------
+
+/*! Runs the z80 on a thread of its own, for multi-core systems. The z80
+	and TLCS-900h only wait for each other when they communicate, the
+	emulation is identical to the single threaded one. Returns FALSE if
+	the thread could not be started. */
+
+	BOOL z80_thread_start(void);
+	void z80_thread_stop(void);
+
+/*! Draws whole frames at VBL, from the state captured at each scanline,
+	instead of drawing every scanline as it completes. The frame is split
+	into 'bands' horizontal bands, all but one drawn by worker threads.
+	The output is identical to line by line drawing. Returns FALSE if the
+	workers could not be started. */
+
+	BOOL gfx_deferred_start(int bands);
+	void gfx_deferred_stop(void);
+
+/*! With deferred drawing started and 3 frame buffers set (see
+	gfx_frame_buffers), draws each frame on a thread of its own while the
+	next one is emulated. 'cfb' is then one frame behind the emulation.
+	Returns FALSE if the thread could not be started. */
+
+	BOOL gfx_pipeline_start(void);
+	void gfx_pipeline_stop(void);
+
+/*! Splits gfx_filter into bands for 'threads' threads, all but one of
+	them workers. Returns FALSE if the workers could not be started. */
+
+	BOOL gfx_filter_start(int threads);
+	void gfx_filter_stop(void);
+
+		//=========================================
+
+/*! Starts a new thread running 'entry(param)'. Return FALSE on failure */
+
+	BOOL system_thread_start(void (*entry)(void*), void* param);
+
+/*! Creates a counting semaphore with the given initial count, returns
+	NULL on failure. */
+
+	void* system_sem_create(int count);
+	void system_sem_destroy(void* sem);
+
+/*! Increments the semaphore count. */
+
+	void system_sem_post(void* sem);
+
+/*! Blocks until the semaphore count is non-zero, then decrements it. */
+
+	void system_sem_wait(void* sem);
+
+/*! Returns a free running count of microseconds, used for timing. */
+
+	_u32 system_get_time(void);
+
+
 //-----------------------------------------------------------------------------
 // Core <--> System-IO Interface
 //-----------------------------------------------------------------------------
@@ -374,6 +533,40 @@ RomHeader;
 
 		//=========================================
 
+	typedef enum
+	{
+		CAPTURE_Y4M,	//YUV4MPEG2, 4:4:4
+		CAPTURE_RAW,	//The frames as drawn, in 'cfb_format', no header
+
+		//Options, or'ed with one of the above
+		CAPTURE_OPTIONS = 0x100,
+		CAPTURE_PCM = CAPTURE_OPTIONS,	//Sound with no WAV header
+		CAPTURE_WAIT = 0x200,			//Wait for the writer, drop nothing
+	}
+	CAPTURE_FORMAT;
+
+/*! Records every frame from VBL to 'video_filename' and the sound rendered
+	for it to 'audio_filename' as a WAV, either may be NULL. The
+	files are written by a thread of their own, the emulation never waits
+	for them unless CAPTURE_WAIT is given, for runs without a display or
+	sound output going as fast as they can. 'cfb_format' must not change
+	while capturing. */
+
+	BOOL capture_start(char* video_filename, CAPTURE_FORMAT format, 
+					   char* audio_filename, int sample_rate);
+
+/*! Finishes writing what was queued and closes the files. Frames and
+	sound dropped because the writer fell behind are reported with
+	system_message. */
+
+	void capture_stop(void);
+
+/*! The number of frames dropped so far */
+
+	_u32 capture_dropped(void);
+
+		//=========================================
+
 /*! Reads a byte from the other system. If no data is available or no
 	high-level communications have been established, then return FALSE.
 	If buffer is NULL, then no data is read, only status is returned */
@@ -424,6 +617,19 @@ RomHeader;
 	BOOL system_io_state_write(char* filename, _u8* buffer, _u32 bufferLength);
 
 
+/*! Creates the file specified by 'filename' for a stream of writes, such
+	as a capture. Returns NULL on failure. */
+
+	void* system_io_stream_open(char* filename);
+	BOOL system_io_stream_write(void* stream, void* buffer, _u32 bufferLength);
+	void system_io_stream_close(void* stream);
+
+
+/*! Moves the next write to 'offset' bytes from the start of the stream */
+
+	void system_io_stream_seek(void* stream, _u32 offset);
+
+
 //-----------------------------------------------------------------------------
 // Core <--> System-Debugger Interface
 //-----------------------------------------------------------------------------
@@ -80,9 +80,12 @@
  *                                                                      *
  ************************************************************************/
 
+#include <math.h>
 #include "neopop.h"
 #include "mem.h"
 #include "sound.h"
+#include "interrupt.h"
+#include "capture.h"
 
 //=============================================================================
 
@@ -91,12 +94,6 @@ BOOL mute;
 SoundChip toneChip;
 SoundChip noiseChip;
 
-//==== DAC
-#define DAC_BUFFERSIZE		256 * 1024
-
-int dacBufferRead, dacBufferWrite, dacBufferCount;
-_u8 dacBufferL[DAC_BUFFERSIZE];
-
 //=============================================================================
 
 #define SOUNDCHIPCLOCK	(3072000)	//Unverified / sounds correct
@@ -121,179 +118,650 @@ static _u32 UpdateStep;	//Number of steps during one sample.
 
 //=============================================================================
 
-static _u16 sample_chip_tone(void)
+//Band-limited synthesis: every time a channel's output level changes, the
+//difference is added to a delta buffer as a short windowed sinc at the
+//exact time of the change. Summing the deltas gives the output, without
+//the aliasing of sampling the square waves directly. The output runs
+//BLEP_TAPS/2 samples behind the chips. Each side of the stereo output has
+//a synth of its own, which sums all of its channels.
+
+#define BLEP_PHASE_BITS	5
+#define BLEP_PHASES		(1 << BLEP_PHASE_BITS)	//Timing resolution, per sample
+#define BLEP_TAPS		16
+#define BLEP_SHIFT		15		//Each phase of the kernel sums to 1 << 15
+#define BLOCK			512		//Samples synthesised at once
+
+#define PI				3.14159265358979
+
+static int blep[BLEP_PHASES][BLEP_TAPS];
+
+typedef struct
 {
-	int i;
+	int delta[BLOCK + BLEP_TAPS + 1];
+	int sum;		//Running total of 'delta', << BLEP_SHIFT
+	int level[5];	//Level of each channel, as already added to 'delta'
+}
+Synth;
 
-	int vol[4];
-	unsigned int out;
-	int left;
+#define DAC_CHANNEL		4		//After the three tones and the noise
 
-	/* vol[] keeps track of how long each square wave stays */
-	/* in the 1 position during the sample period. */
-	vol[0] = vol[1] = vol[2] = vol[3] = 0;
+static Synth leftSynth, rightSynth;
 
-	for (i = 0; i < 3; i++)
+static void blepInit(void)
+{
+	int p, k;
+
+	for (p = 0; p < BLEP_PHASES; p++)
 	{
-		if (toneChip.Output[i]) vol[i] += toneChip.Count[i];
-		toneChip.Count[i] -= STEP;
-
-		/* Period[i] is the half period of the square wave. Here, in each */
-		/* loop I add Period[i] twice, so that at the end of the loop the */
-		/* square wave is in the same status (0 or 1) it was at the start. */
-		/* vol[i] is also incremented by Period[i], since the wave has been 1 */
-		/* exactly half of the time, regardless of the initial position. */
-		/* If we exit the loop in the middle, Output[i] has to be inverted */
-		/* and vol[i] incremented only if the exit status of the square */
-		/* wave is 1. */
-
-		while (toneChip.Count[i] <= 0)
+		double row[BLEP_TAPS], total = 0;
+		int sum = 0, peak = 0;
+
+		for (k = 0; k < BLEP_TAPS; k++)
 		{
-			toneChip.Count[i] += toneChip.Period[i];
-			if (toneChip.Count[i] > 0)
-			{
-				toneChip.Output[i] ^= 1;
-				if (toneChip.Output[i]) vol[i] += toneChip.Period[i];
-				break;
-			}
-			toneChip.Count[i] += toneChip.Period[i];
-			vol[i] += toneChip.Period[i];
+			//Cut off a little below half the sample rate
+			double x = k - (BLEP_TAPS / 2) + 1 - ((double)p / BLEP_PHASES);
+			double w = 0.42 + 0.5 * cos(2 * PI * x / BLEP_TAPS) + 
+				0.08 * cos(4 * PI * x / BLEP_TAPS);
+			double s = (x == 0) ? 1 : sin(PI * 0.9 * x) / (PI * 0.9 * x);
+
+			row[k] = s * w;
+			total += row[k];
 		}
-		if (toneChip.Output[i]) vol[i] -= toneChip.Count[i];
+
+		for (k = 0; k < BLEP_TAPS; k++)
+		{
+			blep[p][k] = (int)floor(((row[k] / total) * (1 << BLEP_SHIFT)) + 0.5);
+			sum += blep[p][k];
+			if (blep[p][k] > blep[p][peak])
+				peak = k;
+		}
+
+		//Exactly 1 << BLEP_SHIFT, so the sum never drifts
+		blep[p][peak] += (1 << BLEP_SHIFT) - sum;
 	}
+}
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+//'time' is in 1/STEP samples from the start of the block. With SSE2 or
+//NEON the kernel is scaled and added 4 taps at a time.
+static __inline void blepStep(Synth* synth, int time, int amplitude)
+{
+	const int* kernel = blep[(time >> (16 - BLEP_PHASE_BITS)) & (BLEP_PHASES - 1)];
+	int* delta = synth->delta + (time >> 16);
+	int k;
+
+#if defined(__SSE2__)
 
-	left = STEP;
-	do
+	//No 32-bit multiply, the even and odd taps are multiplied separately
+	//and only the low halves of the products kept
+	__m128i scale = _mm_set1_epi32(amplitude);
+
+	for (k = 0; k < BLEP_TAPS; k += 4)
 	{
-		int nextevent;
+		__m128i taps = _mm_loadu_si128((const __m128i*)(kernel + k));
+		__m128i even = _mm_mul_epu32(taps, scale);
+		__m128i odd = _mm_mul_epu32(_mm_srli_si128(taps, 4), scale);
+		__m128i product = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, 0x08), 
+			_mm_shuffle_epi32(odd, 0x08));
+
+		_mm_storeu_si128((__m128i*)(delta + k), _mm_add_epi32(
+			_mm_loadu_si128((const __m128i*)(delta + k)), product));
+	}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+	for (k = 0; k < BLEP_TAPS; k += 4)
+		vst1q_s32(delta + k, vmlaq_n_s32(vld1q_s32(delta + k), 
+			vld1q_s32(kernel + k), amplitude));
+
+#else
 
-		if (toneChip.Count[3] < left) nextevent = toneChip.Count[3];
-		else nextevent = left;
+	for (k = 0; k < BLEP_TAPS; k++)
+		delta[k] += amplitude * kernel[k];
 
-		if (toneChip.Output[3]) vol[3] += toneChip.Count[3];
-		toneChip.Count[3] -= nextevent;
-		if (toneChip.Count[3] <= 0)
+#endif
+}
+
+static __inline void setLevel(Synth* synth, int c, int time, int level)
+{
+	if (level != synth->level[c])
+	{
+		blepStep(synth, time, level - synth->level[c]);
+		synth->level[c] = level;
+	}
+}
+
+//=============================================================================
+
+//The tone chip sets the tone periods and the left volumes, the noise chip
+//the noise mode and the right volumes. Channel 'c' goes to each side at
+//its volume there, scaled by 'scale' in quarters. The chips are halved so
+//a side has the same range as the old mono mix, the DAC is added on top.
+static __inline void setStereo(int c, int time, int scale)
+{
+	setLevel(&leftSynth, c, time, (toneChip.Volume[c] * scale) >> 3);
+	setLevel(&rightSynth, c, time, (noiseChip.Volume[c] * scale) >> 3);
+}
+
+//Tone channel 'c', between two times (1/STEP samples) in the block
+static void synthTone(int c, int from, int to)
+{
+	SoundChip* chip = &toneChip;
+	int time = from + chip->Count[c];
+
+	//Above half the sample rate, only the average level can be heard
+	if (chip->Period[c] < STEP)
+	{
+		setStereo(c, from, 2);
+
+		if (time <= to)
+		{
+			int flips = ((to - time) / chip->Period[c]) + 1;
+			chip->Output[c] ^= (flips & 1);
+			time += flips * chip->Period[c];
+		}
+	}
+	else
+	{
+		setStereo(c, from, chip->Output[c] ? 4 : 0);
+
+		for (; time <= to; time += chip->Period[c])
 		{
-			if (toneChip.RNG & 1) toneChip.RNG ^= toneChip.NoiseFB;
-			toneChip.RNG >>= 1;
-			toneChip.Output[3] = toneChip.RNG & 1;
-			toneChip.Count[3] += toneChip.Period[3];
-			if (toneChip.Output[3]) vol[3] += toneChip.Period[3];
+			chip->Output[c] ^= 1;
+			setStereo(c, time, chip->Output[c] ? 4 : 0);
 		}
-		if (toneChip.Output[3]) vol[3] -= toneChip.Count[3];
+	}
+
+	chip->Count[c] = time - to;
+}
+
+//The noise channel
+static void synthNoise(int from, int to)
+{
+	SoundChip* chip = &noiseChip;
+	int time = from + chip->Count[3];
 
-		left -= nextevent;
-	} while (left > 0);
+	setStereo(3, from, chip->Output[3] ? 4 : 0);
 
+	for (; time <= to; time += chip->Period[3])
+	{
+		if (chip->RNG & 1) chip->RNG ^= chip->NoiseFB;
+		chip->RNG >>= 1;
+		chip->Output[3] = chip->RNG & 1;
+
+		setStereo(3, time, chip->Output[3] ? 4 : 0);
+	}
 
-	out = vol[0] * toneChip.Volume[0] + vol[1] * toneChip.Volume[1] +
-		vol[2] * toneChip.Volume[2];
+	chip->Count[3] = time - to;
+}
 
-	if (out > MAX_OUTPUT * STEP) out = MAX_OUTPUT * STEP;
+static void synthSpan(int from, int to)
+{
+	synthTone(0, from, to);
+	synthTone(1, from, to);
+	synthTone(2, from, to);
+	synthNoise(from, to);
+}
 
-	return out / STEP;
+static __inline _u16 clip(int sample)
+{
+	return (_u16)max(-MAX_OUTPUT, min(sample, MAX_OUTPUT));
+}
+
+//Keeps the deltas after the first 'count' samples, for the next block
+static void synthKeep(Synth* synth, int count)
+{
+	memmove(synth->delta, synth->delta + count, (BLEP_TAPS + 1) * sizeof(int));
+	memset(synth->delta + BLEP_TAPS + 1, 0, count * sizeof(int));
+}
+
+//Sums the deltas of both sides into 'count' stereo samples of 'out'. With
+//SSE2 or NEON, 4 samples of each side are summed at once, then narrowed 
+//with saturation and interleaved into 8 outputs.
+static void synthOutput(_u16* out, int count)
+{
+	int left = leftSynth.sum, right = rightSynth.sum;
+	int i = 0;
+
+#if defined(__SSE2__)
+
+	__m128i l = _mm_set1_epi32(left), r = _mm_set1_epi32(right);
+	__m128i lowest = _mm_set1_epi16(-MAX_OUTPUT);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i dl = _mm_loadu_si128((const __m128i*)&leftSynth.delta[i]);
+		__m128i dr = _mm_loadu_si128((const __m128i*)&rightSynth.delta[i]);
+		__m128i both;
+
+		//Running totals within the vector, then the carry from the last one
+		dl = _mm_add_epi32(dl, _mm_slli_si128(dl, 4));
+		dr = _mm_add_epi32(dr, _mm_slli_si128(dr, 4));
+		dl = _mm_add_epi32(dl, _mm_slli_si128(dl, 8));
+		dr = _mm_add_epi32(dr, _mm_slli_si128(dr, 8));
+		l = _mm_add_epi32(_mm_shuffle_epi32(l, 0xFF), dl);
+		r = _mm_add_epi32(_mm_shuffle_epi32(r, 0xFF), dr);
+
+		both = _mm_packs_epi32(_mm_srai_epi32(l, BLEP_SHIFT), _mm_srai_epi32(r, BLEP_SHIFT));
+		both = _mm_max_epi16(both, lowest);
+		_mm_storeu_si128((__m128i*)(out + (i * 2)), 
+			_mm_unpacklo_epi16(both, _mm_unpackhi_epi64(both, both)));
+	}
+
+	left = _mm_cvtsi128_si32(_mm_shuffle_epi32(l, 0xFF));
+	right = _mm_cvtsi128_si32(_mm_shuffle_epi32(r, 0xFF));
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+	int32x4_t l = vdupq_n_s32(left), r = vdupq_n_s32(right), zero = vdupq_n_s32(0);
+	int16x4_t lowest = vdup_n_s16(-MAX_OUTPUT);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		int32x4_t dl = vld1q_s32(&leftSynth.delta[i]);
+		int32x4_t dr = vld1q_s32(&rightSynth.delta[i]);
+		int16x4x2_t both;
+
+		//Running totals within the vector, then the carry from the last one
+		dl = vaddq_s32(dl, vextq_s32(zero, dl, 3));
+		dr = vaddq_s32(dr, vextq_s32(zero, dr, 3));
+		dl = vaddq_s32(dl, vextq_s32(zero, dl, 2));
+		dr = vaddq_s32(dr, vextq_s32(zero, dr, 2));
+		l = vaddq_s32(vdupq_n_s32(vgetq_lane_s32(l, 3)), dl);
+		r = vaddq_s32(vdupq_n_s32(vgetq_lane_s32(r, 3)), dr);
+
+		both.val[0] = vmax_s16(vqmovn_s32(vshrq_n_s32(l, BLEP_SHIFT)), lowest);
+		both.val[1] = vmax_s16(vqmovn_s32(vshrq_n_s32(r, BLEP_SHIFT)), lowest);
+		vst2_s16((int16_t*)(out + (i * 2)), both);
+	}
+
+	left = vgetq_lane_s32(l, 3);
+	right = vgetq_lane_s32(r, 3);
+
+#endif
+
+	for (; i < count; i++)
+	{
+		left += leftSynth.delta[i];
+		right += rightSynth.delta[i];
+		out[i * 2] = clip(left >> BLEP_SHIFT);
+		out[(i * 2) + 1] = clip(right >> BLEP_SHIFT);
+	}
+
+	leftSynth.sum = left;
+	rightSynth.sum = right;
+	synthKeep(&leftSynth, count);
+	synthKeep(&rightSynth, count);
 }
 
 //=============================================================================
 
-static _u16 sample_chip_noise(void)
+//Register and DAC writes are queued by the CPUs with the tick they happened
+//on, and applied here at the matching point in the block, so only the
+//renderer ever touches the chips. The CPU side only advances 'logWritten'
+//and the renderer only 'logRead', so no lock is needed. Each side puts a
+//barrier between the other's counter and the entries, and between the
+//entries and its own counter. The z80 is caught up just before each VBL
+//renders up to the present, so the log only has to hold a frame of writes.
+
+#define CPU_CLOCK		6144000		//TLCS-900h ticks per second
+#define FRAME_TICKS		(199 * TIMER_HINT_RATE)
+#define MAX_LAG			(CPU_CLOCK / 4)
+
+//A TLCS-900h store takes at least 4 ticks, and a word stored to the DACs
+//is two writes. The log holds a frame at that rate.
+#define LOG_TICKS		2			//Fewest ticks per write
+#define LOG_SIZE		65536		//Writes, a power of 2
+
+#if LOG_SIZE < FRAME_TICKS / LOG_TICKS
+#error LOG_SIZE is too small for a frame of writes
+#endif
+
+#define DAC_SHIFT		6			//DAC level, around 0x80, to output
+
+enum
 {
-	int i;
+	LOG_TONE,
+	LOG_NOISE,
+	LOG_DAC_LEFT,
+	LOG_DAC_RIGHT,
+};
+
+typedef struct
+{
+	_u32 time;
+	_u8 target, data;
+}
+LogEntry;
 
-	int vol[4];
-	unsigned int out;
-	int left;
+static LogEntry writeLog[LOG_SIZE];
+static volatile _u32 logWritten, logRead;
+static _u32 logDropped;		//Writes lost to a full log, since reported
 
-	/* vol[] keeps track of how long each square wave stays */
-	/* in the 1 position during the sample period. */
-	vol[0] = vol[1] = vol[2] = vol[3] = 0;
+static _u32 renderTime, renderFrac;	//Tick of the next sample, and 1/65536ths
+static _u32 tickStep;				//Ticks per sample, 16.16 fixed point
+static _u32 nominalStep;			//'tickStep' at exactly the output rate
+static int sampleRate;
+
+static void logWrite(_u8 target, _u8 data, _u32 time)
+{
+	LogEntry* entry;
 
-	for (i = 0; i < 3; i++)
+	//Full, the renderer has stopped
+	if (logWritten - logRead == LOG_SIZE)
 	{
-		if (noiseChip.Output[i]) vol[i] += noiseChip.Count[i];
-		noiseChip.Count[i] -= STEP;
-
-		/* Period[i] is the half period of the square wave. Here, in each */
-		/* loop I add Period[i] twice, so that at the end of the loop the */
-		/* square wave is in the same status (0 or 1) it was at the start. */
-		/* vol[i] is also incremented by Period[i], since the wave has been 1 */
-		/* exactly half of the time, regardless of the initial position. */
-		/* If we exit the loop in the middle, Output[i] has to be inverted */
-		/* and vol[i] incremented only if the exit status of the square */
-		/* wave is 1. */
-
-		while (noiseChip.Count[i] <= 0)
-		{
-			noiseChip.Count[i] += noiseChip.Period[i];
-			if (noiseChip.Count[i] > 0)
-			{
-				noiseChip.Output[i] ^= 1;
-				if (noiseChip.Output[i]) vol[i] += noiseChip.Period[i];
-				break;
-			}
-			noiseChip.Count[i] += noiseChip.Period[i];
-			vol[i] += noiseChip.Period[i];
-		}
-		if (noiseChip.Output[i]) vol[i] -= noiseChip.Count[i];
+		logDropped++;
+		return;
 	}
 
-	left = STEP;
-	do
+	MEMORY_BARRIER();
+	entry = &writeLog[logWritten & (LOG_SIZE - 1)];
+	entry->time = time;
+	entry->target = target;
+	entry->data = data;
+
+	MEMORY_BARRIER();
+	logWritten++;
+}
+
+void sound_write(SoundChip* chip, _u8 data, _u32 time)
+{
+	//Nothing renders while muted, so the chip can't be in use
+	if (mute)
+		WriteSoundChip(chip, data);
+	else
+		logWrite((chip == &toneChip) ? LOG_TONE : LOG_NOISE, data, time);
+}
+
+void dac_write(_u8 right, _u8 data, _u32 time)
+{
+	if (mute) return;	// Ignore
+
+	logWrite(right ? LOG_DAC_RIGHT : LOG_DAC_LEFT, data, time);
+}
+
+//'time' is where in the block it happens, for the DACs. Each holds its
+//level from one write to the next.
+static void apply(LogEntry* entry, int time)
+{
+	int level = ((int)entry->data - 0x80) << DAC_SHIFT;
+
+	switch (entry->target)
+	{
+	case LOG_TONE:	WriteSoundChip(&toneChip, entry->data);		break;
+	case LOG_NOISE:	WriteSoundChip(&noiseChip, entry->data);	break;
+	case LOG_DAC_LEFT:	setLevel(&leftSynth, DAC_CHANNEL, time, level);		break;
+	case LOG_DAC_RIGHT:	setLevel(&rightSynth, DAC_CHANNEL, time, level);	break;
+	}
+}
+
+void sound_flush(void)
+{
+	while (logRead != logWritten)
+	{
+		LogEntry* entry = &writeLog[logRead & (LOG_SIZE - 1)];
+
+		MEMORY_BARRIER();
+
+		//The DAC levels are only kept by the renderer
+		if (entry->target == LOG_TONE || entry->target == LOG_NOISE)
+			apply(entry, 0);
+
+		MEMORY_BARRIER();
+		logRead++;
+	}
+}
+
+//Renders 'count' stereo samples into 'out'
+static void synthBlock(_u16* out, int count)
+{
+	_u64 span = ((_u64)count * tickStep) + renderFrac;
+	_u32 ticks = (_u32)(span >> 16);
+	int from = 0, length = count * STEP;
+
+	while (logRead != logWritten)
 	{
-		int nextevent;
+		LogEntry* entry = &writeLog[logRead & (LOG_SIZE - 1)];
+		_s32 elapsed;
+		int at = 0;
+
+		MEMORY_BARRIER();
+		elapsed = (_s32)(entry->time - renderTime);
+
+		if (elapsed >= (_s32)ticks)
+			break;
+
+		//Late writes are applied straight away
+		if (elapsed > 0)
+			at = (int)(((((_s64)elapsed << 16) - renderFrac) << 16) / tickStep);
+
+		at = max(from, min(at, length));
+		synthSpan(from, at);
+		apply(entry, at);
+
+		from = at;
+		MEMORY_BARRIER();
+		logRead++;
+	}
+
+	synthSpan(from, length);
+
+	renderTime += ticks;
+	renderFrac = (_u32)span & 0xFFFF;
+
+	synthOutput(out, count);
+}
+
+//=============================================================================
+
+//The sound is rendered by the emulation as each frame completes, into a ring
+//the output takes from. The emulation only advances 'ringWritten' and the
+//output only 'ringRead', with barriers as for the write log. The rate is
+//nudged by up to MAX_ADJUST parts per million to keep the ring near
+//'sound_latency' samples full. Steps can go at any fraction of a sample, so
+//this is just a change to 'tickStep'. Free running, the output takes each
+//frame as it is, and the rate never moves.
 
-		if (noiseChip.Count[3] < left) nextevent = noiseChip.Count[3];
-		else nextevent = left;
+#define RING_SIZE		8192		//Stereo samples, a power of 2
+#define MAX_ADJUST		5000		//0.5%
 
-		if (noiseChip.Output[3]) vol[3] += noiseChip.Count[3];
-		noiseChip.Count[3] -= nextevent;
-		if (noiseChip.Count[3] <= 0)
+int sound_latency;
+
+static _u16 ring[RING_SIZE][2];
+static volatile _u32 ringWritten, ringRead;
+static _u16 discard[BLOCK][2];		//Rendered while the ring is full
+static _u16 lastSample[2];			//Repeated while the ring is refilling
+static BOOL primed;					//Has enough to play from
+static int ringFill;				//Averaged, in 1/16ths of a sample
+
+static int latency(void)
+{
+	return (sound_latency > 0) ? sound_latency : sampleRate / 20;
+}
+
+static void adjustRate(void)
+{
+	int target = latency();
+	int adjust;
+
+	if (sound_latency == SOUND_FREE_RUN)
+	{
+		tickStep = nominalStep;
+		return;
+	}
+
+	ringFill += (int)(((ringWritten - ringRead) << 4) - ringFill) / 8;
+
+	//Below the target, make more samples from the same time. The full
+	//adjustment is reached half the target away from it.
+	adjust = (int)(((_s64)((target << 4) - ringFill) * MAX_ADJUST * 2) / (target << 4));
+	adjust = max(-MAX_ADJUST, min(adjust, MAX_ADJUST));
+
+	tickStep = nominalStep - (_u32)(((_s64)nominalStep * adjust) / 1000000);
+}
+
+void sound_frame(void)
+{
+	_u32 now = TIMER_NOW;
+	_s32 lag = (_s32)(now - renderTime);
+	int count;
+
+	if (logDropped)
+	{
+		system_message("Sound: %d register writes dropped", logDropped);
+		logDropped = 0;
+	}
+
+	if (mute || lag <= 0)
+		return;
+
+	//Too far behind to catch up with, the writes missed are still made
+	if (lag > MAX_LAG)
+	{
+		sound_flush();
+		renderTime = now;
+		renderFrac = 0;
+		return;
+	}
+
+	adjustRate();
+	count = (int)((((_u64)lag << 16) - renderFrac) / tickStep);
+
+	//Straight into the ring, up to where it wraps. Whatever doesn't fit
+	//is rendered and lost, so the chips keep time.
+	while (count > 0)
+	{
+		_u32 start = ringWritten & (RING_SIZE - 1);
+		_u32 space = RING_SIZE - (ringWritten - ringRead);
+		int block = min(count, BLOCK);
+
+		MEMORY_BARRIER();
+
+		if (space == 0)
 		{
-			if (noiseChip.RNG & 1) noiseChip.RNG ^= noiseChip.NoiseFB;
-			noiseChip.RNG >>= 1;
-			noiseChip.Output[3] = noiseChip.RNG & 1;
-			noiseChip.Count[3] += noiseChip.Period[3];
-			if (noiseChip.Output[3]) vol[3] += noiseChip.Period[3];
+			synthBlock(discard[0], block);
+			capture_sound(discard[0], block);
 		}
-		if (noiseChip.Output[3]) vol[3] -= noiseChip.Count[3];
+		else
+		{
+			block = min(block, (int)min(space, RING_SIZE - start));
+			synthBlock(ring[start], block);
+			capture_sound(ring[start], block);
+
+			MEMORY_BARRIER();
+			ringWritten += block;
+		}
+
+		count -= block;
+	}
+}
+
+//=============================================================================
 
-		left -= nextevent;
-	} while (left > 0);
+//After running dry, wait for the ring to refill rather than playing it a
+//few samples at a time. Far too full (the output stalled), skip ahead.
+//Takes up to '*count' samples in one piece, setting '*count' to how many,
+//or returns 'lastSample' to repeat while refilling. They stay in the ring
+//until given back with release().
+static _u16* take(int* count)
+{
+	_u32 fill = ringWritten - ringRead;
+	_u32 start = ringRead & (RING_SIZE - 1);
+	int target = latency();
 
+	if (fill > (_u32)(4 * target))
+	{
+		ringRead = ringWritten - target;
+		start = ringRead & (RING_SIZE - 1);
+		fill = target;
+	}
 
-	out = vol[3] * noiseChip.Volume[3];
+	if (fill == 0)
+		primed = FALSE;
+	else if (fill >= (_u32)target)
+		primed = TRUE;
+
+	if (!primed)
+	{
+		*count = 1;
+		return lastSample;
+	}
 
-	if (out > MAX_OUTPUT * STEP) out = MAX_OUTPUT * STEP;
+	*count = (int)min((_u32)*count, min(fill, RING_SIZE - start));
 
-	return out / STEP;
+	MEMORY_BARRIER();
+	lastSample[0] = ring[start + *count - 1][0];
+	lastSample[1] = ring[start + *count - 1][1];
+	return ring[start];
 }
 
-//=============================================================================
+static void release(_u16* in, int count)
+{
+	if (in != lastSample)
+	{
+		MEMORY_BARRIER();
+		ringRead += count;
+	}
+}
 
 void sound_update_stereo(_u16* chip_buffer, int length_bytes)
 {
-	while (length_bytes > 0)
+	int count = length_bytes / 4;	// 4 bytes = 2 * 16 bits
+
+	while (count > 0)
 	{
-		//Mix a stereo track out of: (Tone + Noise) >> 1
-		//Write it to the sound buffer
-		_u16 sample = (sample_chip_tone() + sample_chip_noise()) >> 1;
-		*(chip_buffer++) = sample;
-		*(chip_buffer++) = sample;
+		int length = count;
+		_u16* in = take(&length);
 
-		length_bytes -= 4;	// 4 bytes = 2 * 16 bits
+		memcpy(chip_buffer, in, length * 4);
+		release(in, length);
+		chip_buffer += length * 2;
+		count -= length;
 	}
 }
 
 void sound_update(_u16* chip_buffer, int length_bytes)
 {
-	while (length_bytes > 0)
+	int count = length_bytes / 2;	// 2 bytes = 16 bits
+
+	while (count > 0)
+	{
+		int i, length = count;
+		_u16* in = take(&length);
+
+		for (i = 0; i < length; i++)
+			*(chip_buffer++) = ((_s16)in[i * 2] + (_s16)in[i * 2 + 1]) >> 1;
+
+		release(in, length);
+		count -= length;
+	}
+}
+
+//Everything queued, in at most two pieces where the ring wraps
+int sound_update_frame(_u16* chip_buffer, int max_samples)
+{
+	int count = 0;
+
+	while (count < max_samples && ringRead != ringWritten)
 	{
-		//Mix a mono track out of: (Tone + Noise) >> 1
-		//Write it to the sound buffer
-		*(chip_buffer++) = (sample_chip_tone() + sample_chip_noise()) >> 1;
+		_u32 start = ringRead & (RING_SIZE - 1);
+		_u32 length = min(ringWritten - ringRead, RING_SIZE - start);
+
+		length = min(length, (_u32)(max_samples - count));
+		MEMORY_BARRIER();
+		memcpy(chip_buffer + (count * 2), ring[start], length * sizeof(ring[0]));
 
-		length_bytes -= 2;	// 2 bytes = 16 bits
+		MEMORY_BARRIER();
+		ringRead += length;
+		count += length;
 	}
+
+	return count;
 }
 
 //=============================================================================
@@ -411,49 +879,6 @@ void WriteSoundChip(SoundChip* chip, _u8 data)
 
 //=============================================================================
 
-void dac_write(void)
-{
-	if (mute) return;	// Ignore	
-
-	//Write to buffer
-	dacBufferL[dacBufferWrite] = ram[0xA2];
-	dacBufferWrite++;
-	if (dacBufferWrite == DAC_BUFFERSIZE)
-		dacBufferWrite = 0;
-
-	//Overflow?
-	dacBufferCount++;
-	if (dacBufferCount == DAC_BUFFERSIZE)
-	{
-		system_message("dac_write: DAC buffer overflow\nPlease report this to the author.");
-		dacBufferCount = 0;
-	}
-}
-	
-void dac_update(_u8* dac_buffer, int length_bytes)
-{
-	while (length_bytes > 0)
-	{
-		//Copy then clear DAC data
-		*(dac_buffer++) = dacBufferL[dacBufferRead];
-		dacBufferL[dacBufferRead] = 0x80;
-			
-		length_bytes --;	// 1 byte = 8 bits
-
-		if (dacBufferCount > 0)
-		{
-			dacBufferCount --;
-
-			//Advance the DAC read
-			dacBufferRead++;
-			if (dacBufferRead == DAC_BUFFERSIZE)
-				dacBufferRead = 0;
-		}
-	}
-}
-
-//=============================================================================
-
 //Resets the sound chips, also used whenever sound options are changed
 void sound_init(int SampleRate)
 {
@@ -474,6 +899,22 @@ void sound_init(int SampleRate)
 	//Initialise Right Chip
 	memset(&noiseChip, 0, sizeof(SoundChip));
 
+	blepInit();
+	memset(&leftSynth, 0, sizeof(Synth));
+	memset(&rightSynth, 0, sizeof(Synth));
+
+	//Forget queued writes and sound, the chips are reset
+	logRead = logWritten;
+	ringRead = ringWritten;
+	ringFill = 0;
+	primed = FALSE;
+	lastSample[0] = lastSample[1] = 0;
+
+	sampleRate = SampleRate;
+	tickStep = nominalStep = (_u32)(((double)CPU_CLOCK * 65536) / SampleRate);
+	renderTime = TIMER_NOW;
+	renderFrac = 0;
+
 	//Default register settings
 	for (i = 0;i < 8;i+=2)
 	{
@@ -501,15 +942,6 @@ void sound_init(int SampleRate)
 		out /= 1.258925412;	/* = 10 ^ (2/20) = 2dB */
 	}
 	VolTable[15] = 0;
-
-
-	//Clear the DAC buffer
-	for (i = 0; i < DAC_BUFFERSIZE; i++)
-		dacBufferL[i] = 0x80;
-
-	dacBufferCount = 0;
-	dacBufferRead = 0; 
-	dacBufferWrite = 0;
 }
 
 //=============================================================================
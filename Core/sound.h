@@ -62,12 +62,23 @@ extern SoundChip noiseChip;
 
 void WriteSoundChip(SoundChip* chip, _u8 data);
 
-#define Write_SoundChipTone(VALUE)		(WriteSoundChip(&toneChip, VALUE))
-#define Write_SoundChipNoise(VALUE)		(WriteSoundChip(&noiseChip, VALUE))
+//Queues a write for the renderer, 'time' is the TLCS-900h tick it happened
+//on (see TIMER_NOW). The chips are only changed by the renderer.
+void sound_write(SoundChip* chip, _u8 data, _u32 time);
+
+//Applies every queued write now, only while nothing is rendering
+void sound_flush(void);
+
+//Renders the sound up to now, called at VBL
+void sound_frame(void);
+
+#define Write_SoundChipTone(VALUE, TIME)	(sound_write(&toneChip, VALUE, TIME))
+#define Write_SoundChipNoise(VALUE, TIME)	(sound_write(&noiseChip, VALUE, TIME))
 
 //=============================================================================
 
-void dac_write(void);
+//Queues a level for the left or right DAC, played from 'time' until the next
+void dac_write(_u8 right, _u8 data, _u32 time);
 
 //=============================================================================
 #endif
@@ -52,6 +52,7 @@
 #include "interrupt.h"
 #include "dma.h"
 #include "mem.h"
+#include "gfx.h"
 
 //=============================================================================
 
@@ -96,6 +97,9 @@ BOOL state_store(char* filename)
 	NEOPOPSTATE0050	state;
 	int i,j;
 
+	//Wait for the z80 thread
+	Z80_join();
+
 	//Build a state description
 	state.valid_state_id = 0x0050;
 	memcpy(&state.header, rom_header, sizeof(RomHeader));
@@ -118,6 +122,7 @@ BOOL state_store(char* filename)
 	memcpy(&state.Z80_regs, &Z80_regs, sizeof(Z80));
 
 	//Sound Chips
+	sound_flush();
 	memcpy(&state.toneChip, &toneChip, sizeof(SoundChip));
 	memcpy(&state.noiseChip, &noiseChip, sizeof(SoundChip));
 
@@ -198,9 +203,11 @@ static void read_state_0050(char* filename)
 		timer_clock3 = state.timer_clock3;
 
 		//Z80 Registers
+		Z80_join();
 		memcpy(&Z80_regs, &state.Z80_regs, sizeof(Z80));
 
 		//Sound Chips
+		sound_flush();
 		memcpy(&toneChip, &state.toneChip, sizeof(SoundChip));
 		memcpy(&noiseChip, &state.noiseChip, sizeof(SoundChip));
 
@@ -214,7 +221,14 @@ static void read_state_0050(char* filename)
 		}
 
 		//Memory
+		gfx_render_lines();				//Draw any recorded lines first
 		memcpy(ram, &state.ram, 0xC000);
+		gfx_tile_flush();
+		gfx_sprite_gen++;
+		gfx_palette_gen++;
+
+		//Older saves hold a z80 budget that ran down forever
+		Z80_restart();
 	}
 }
 
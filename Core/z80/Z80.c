@@ -47,6 +47,36 @@ INLINE byte RdZ80(word A)
 }
 #endif
 
+/** NeoPop: memory is mapped in 4KB pages. Pages with a     **/
+/** pointer are accessed directly, the others (mailbox,     **/
+/** sound chips, interrupt) go to RdZ80()/WrZ80() in        **/
+/** Z80_interface.c. Opcode fetches read the shared RAM     **/
+/** window at 0x0000-0x0FFF without the page lookup.        **/
+extern byte ram[];
+extern byte *Z80_ReadPage[16];
+extern byte *Z80_WritePage[16];
+
+static __inline byte PageRdZ80(word A)
+{
+  register byte *P=Z80_ReadPage[A>>12];
+  return(P? P[A&0x0FFF]:RdZ80(A));
+}
+
+static __inline void PageWrZ80(word A,byte V)
+{
+  register byte *P=Z80_WritePage[A>>12];
+  if(P) P[A&0x0FFF]=V; else WrZ80(A,V);
+}
+
+/* Sound programs run from the shared RAM at 0x7000 */
+static __inline byte OpZ80(word A)
+{
+  return(A<0x1000? ram[0x7000+A]:PageRdZ80(A));
+}
+
+#define RdZ80 PageRdZ80
+#define WrZ80 PageWrZ80
+
 #define S(Fl)        R->AF.B.l|=Fl
 #define R(Fl)        R->AF.B.l&=~(Fl)
 #define FLAGS(Rg,Fl) R->AF.B.l=Fl|ZSTable[Rg]
@@ -312,7 +342,7 @@ static void CodesCB(register Z80 *R)
 {
   register byte I;
 
-  I=RdZ80(R->PC.W++);
+  I=OpZ80(R->PC.W++);
   R->ICount-=CyclesCB[I];
   switch(I)
   {
@@ -334,7 +364,7 @@ static void CodesDDCB(register Z80 *R)
 
 #define XX IX    
   J.W=R->XX.W+(offset)RdZ80(R->PC.W++);
-  I=RdZ80(R->PC.W++);
+  I=OpZ80(R->PC.W++);
   R->ICount-=CyclesXXCB[I];
   switch(I)
   {
@@ -357,7 +387,7 @@ static void CodesFDCB(register Z80 *R)
 
 #define XX IY
   J.W=R->XX.W+(offset)RdZ80(R->PC.W++);
-  I=RdZ80(R->PC.W++);
+  I=OpZ80(R->PC.W++);
   R->ICount-=CyclesXXCB[I];
   switch(I)
   {
@@ -378,7 +408,7 @@ static void CodesED(register Z80 *R)
   register byte I;
   register pair J;
 
-  I=RdZ80(R->PC.W++);
+  I=OpZ80(R->PC.W++);
   R->ICount-=CyclesED[I];
   switch(I)
   {
@@ -401,7 +431,7 @@ static void CodesDD(register Z80 *R)
   register pair J;
 
 #define XX IX
-  I=RdZ80(R->PC.W++);
+  I=OpZ80(R->PC.W++);
   R->ICount-=CyclesXX[I];
   switch(I)
   {
@@ -428,7 +458,7 @@ static void CodesFD(register Z80 *R)
   register pair J;
 
 #define XX IY
-  I=RdZ80(R->PC.W++);
+  I=OpZ80(R->PC.W++);
   R->ICount-=CyclesXX[I];
   switch(I)
   {
@@ -482,7 +512,7 @@ word ExecZ80(Z80 *R)
   register byte I;
   register pair J;
 
-  I=RdZ80(R->PC.W++);
+  I=OpZ80(R->PC.W++);
   R->ICount-=Cycles[I];
   switch(I)
   {
@@ -581,7 +611,7 @@ word RunZ80(Z80 *R)
       if(!DebugZ80(R)) return(R->PC.W);
 #endif
 
-    I=RdZ80(R->PC.W++);
+    I=OpZ80(R->PC.W++);
     R->ICount-=Cycles[I];
     switch(I)
     {
@@ -19,7 +19,15 @@
 #include "ctrl.h"
 #include "util.h"
 
+#define FRAME_BUFFERS 3
+
+/* Automatic frameskip */
+#define MAX_SKIP_RUN 4     /* Most frames skipped in a row */
+#define RAISE_WAIT   8     /* Frames between raising the skip */
+#define LOWER_WAIT   60    /* Frames lower skip must look affordable */
+
 PspImage *Screen;
+static PspImage *Frames[FRAME_BUFFERS];
 
 static PspFpsCounter FpsCounter;
 static int ScreenX, ScreenY, ScreenW, ScreenH;
@@ -30,6 +38,11 @@ static u64 LastTick;
 static u64 CurrentTick;
 static unsigned char ReturnToMenu;
 
+static u64 FrameTick;
+static int WaitTicks, DrawnCost, SkippedCost, SkipWait;
+static volatile u32 AudioSamples;
+static u32 EmulatedSamples;
+
 extern char *GameName;
 extern EmulatorOptions Options;
 extern const u64 ButtonMask[];
@@ -51,21 +64,51 @@ int InitEmulation()
 	language_english = TRUE;
 	system_colour = COLOURMODE_AUTO;
 
-  /* Create screen buffer */
-  if (!(Screen = pspImageCreateVram(256, 256, PSP_IMAGE_16BPP)))
-    	return 0;
-
-  Screen->Viewport.Width = SCREEN_WIDTH;
-  Screen->Viewport.Height = SCREEN_HEIGHT;
-  Screen->TextureFormat = GU_PSM_4444; /* Override default 5551 */
-  cfb = Screen->Pixels;
+  /* Create screen buffers; the core draws to them in turn */
+  int i;
+  for (i = 0; i < FRAME_BUFFERS; i++)
+  {
+    if (!(Frames[i] = pspImageCreateVram(256, 256, PSP_IMAGE_16BPP)))
+    {
+      if (i == 0) return 0;
+      break;
+    }
+
+    Frames[i]->Viewport.Width = SCREEN_WIDTH;
+    Frames[i]->Viewport.Height = SCREEN_HEIGHT;
+    Frames[i]->TextureFormat = GU_PSM_4444; /* Override default 5551 */
+  }
+
+  /* Frames are textures 256 pixels wide */
+  CFB_DESC desc = { NULL, 256 * sizeof(_u16), CFB_X4B4G4R4, 256, 256 };
+  Screen = Frames[0];
+  desc.base = Screen->Pixels;
+  gfx_frame_buffer(&desc);
+
+  /* Show each frame straight from the buffer it was drawn to */
+  if (Frames[FRAME_BUFFERS - 1])
+  {
+    void *buffers[FRAME_BUFFERS];
+    for (i = 0; i < FRAME_BUFFERS; i++) buffers[i] = Frames[i]->Pixels;
+    gfx_frame_buffers(buffers, FRAME_BUFFERS);
+  }
 
   return 1;
 }
 
+/* Show the buffer the core last completed */
+static void SelectScreen()
+{
+  int i;
+  for (i = 0; i < FRAME_BUFFERS; i++)
+    if (Frames[i] && Frames[i]->Pixels == cfb)
+      Screen = Frames[i];
+}
+
 void system_graphics_update()
-{
-  pspVideoBegin();
+{
+  if (gfx_frame_changed()) SelectScreen();
+  pspVideoBegin();
 
   /* Clear the buffer first, if necessary */
   if (ClearScreen >= 0)
@@ -93,6 +136,9 @@ void system_graphics_update()
   pspVideoEnd();
 
   /* Wait if needed */
+  u64 wait_tick;
+  sceRtcGetCurrentTick(&wait_tick);
+
   if (Options.UpdateFreq)
   {
     do { sceRtcGetCurrentTick(&CurrentTick); }
@@ -102,6 +148,10 @@ void system_graphics_update()
 
   /* Wait for VSync signal */
   if (Options.VSync) pspVideoWaitVSync();
+
+  /* Waiting is not part of the frame's cost */
+  sceRtcGetCurrentTick(&CurrentTick);
+  WaitTicks += (int)(CurrentTick - wait_tick);
 
   pspVideoSwapBuffers();
 }
@@ -151,23 +201,82 @@ void system_input_update()
   }
 }
 
+/* Adjust the frameskip to what can be kept up with. A frame's cost is */
+/* the time taken to emulate and show it, without waiting; the sound */
+/* output shows how far behind the emulation has fallen */
+static void AdaptFrameskip()
+{
+  u64 tick;
+  int cost, period, lag, key = system_frameskip_key;
+
+  sceRtcGetCurrentTick(&tick);
+  cost = (int)(tick - FrameTick) - WaitTicks;
+  FrameTick = tick;
+  WaitTicks = 0;
+
+  /* Drawn and skipped frames cost differently, average them apart */
+  if (frameskip_count == 0) DrawnCost += (cost - DrawnCost) / 8;
+  else SkippedCost += (cost - SkippedCost) / 8;
+
+  period = TicksPerSecond / ((Options.UpdateFreq) ? Options.UpdateFreq : 60);
+
+  /* Samples played that have not been emulated yet; when too far off */
+  /* either way (e.g. when not throttled), start again from here */
+  EmulatedSamples += AUDIO_RATE / 60;
+  lag = (int)(AudioSamples - EmulatedSamples);
+  if (lag > AUDIO_RATE / 4 || lag < -AUDIO_RATE / 4)
+  {
+    EmulatedSamples = AudioSamples;
+    lag = 0;
+  }
+
+  SkipWait++;
+
+  /* Over budget, skip one more as soon as the last change has settled */
+  if (((SkippedCost * (key - 1) + DrawnCost) / key > period
+        || lag > 2 * AUDIO_RATE / 60)
+      && key <= MAX_SKIP_RUN)
+  {
+    if (SkipWait >= RAISE_WAIT) { key++; SkipWait = 0; }
+  }
+  /* Skip one less once that has looked affordable for long enough */
+  else if (key > 1
+      && (SkippedCost * (key - 2) + DrawnCost) / (key - 1) < period * 7 / 8
+      && lag < AUDIO_RATE / 60)
+  {
+    if (SkipWait >= LOWER_WAIT) { key--; SkipWait = 0; }
+  }
+  else SkipWait = (SkipWait < RAISE_WAIT) ? SkipWait : RAISE_WAIT;
+
+  if (key != system_frameskip_key)
+  {
+    system_frameskip_key = key;
+    if (Options.UpdateFreq)
+      TicksPerUpdate = TicksPerSecond / (Options.UpdateFreq / key);
+  }
+}
+
 /*! Called at the start of the vertical blanking period */
 void system_VBL(void)
-{
+{
 	/* Update Graphics */
-  if (frameskip_count == 0)
-    system_graphics_update();
+  if (frameskip_count == 0)
+    system_graphics_update();
 
 	/* Update Input */
 	system_input_update();
 
-	/* Sound update performed in the callback */
+	/* Sound update performed in the callback */
+
+  if (Options.Frameskip == FRAMESKIP_AUTO)
+    AdaptFrameskip();
 }
 
 /* Run emulation */
 void RunEmulation()
 {
   float ratio;
+  int i;
 
   /* Recompute screen size/position */
   switch (Options.DisplayMode)
@@ -193,18 +302,34 @@ void RunEmulation()
 
   /* Initialize performance counter */
   pspPerfInitFps(&FpsCounter);
-  pspImageClear(Screen, 0);
-
+  for (i = 0; i < FRAME_BUFFERS; i++)
+    if (Frames[i]) pspImageClear(Frames[i], 0);
+
   /* Recompute update frequency */
   TicksPerSecond = sceRtcGetTickResolution();
+  if (Options.Frameskip == FRAMESKIP_AUTO)
+  {
+    /* Start without skipping, AdaptFrameskip takes it from there */
+    system_frameskip_key = 1;
+    frameskip_count = 0;
+    DrawnCost = SkippedCost = SkipWait = WaitTicks = 0;
+    EmulatedSamples = AudioSamples;
+    sceRtcGetCurrentTick(&FrameTick);
+  }
+  else system_frameskip_key = Options.Frameskip + 1; /* 1 - 7 */
+
   if (Options.UpdateFreq)
   {
-    TicksPerUpdate = TicksPerSecond 
-      / (Options.UpdateFreq / (Options.Frameskip + 1));
+    TicksPerUpdate = TicksPerSecond 
+      / (Options.UpdateFreq / system_frameskip_key);
     sceRtcGetCurrentTick(&LastTick);
   }
 
-	system_frameskip_key = Options.Frameskip + 1; /* 1 - 7 */
+  if (!Options.Z80Thread || !z80_thread_start()) z80_thread_stop();
+  gfx_plane_cache = Options.PlaneCache;
+  /* Single core, so a single band */
+  if (!Options.DeferRender || !gfx_deferred_start(1)) gfx_deferred_stop();
+  else if (Options.RenderThread) gfx_pipeline_start();
   ReturnToMenu = 0;
   ClearScreen = 1;
 
@@ -220,6 +345,10 @@ void RunEmulation()
   while (!ExitPSP && !ReturnToMenu)
     emulate();
 
+  /* Let the menu see the newest frame */
+  gfx_pipeline_stop();
+  SelectScreen();
+
   /* Stop sound */
   if (!mute) pspAudioSetChannelCallback(0, NULL, 0);
 
@@ -229,6 +358,7 @@ void RunEmulation()
 void AudioCallback(void* buf, unsigned int *length, void *userdata)
 {
   int length_bytes = *length << 2; /* 4 bytes per stereo sample */
+  AudioSamples += *length;
 
   /* If the sound buffer's not ready, render silence */
   if (ExitPSP || ReturnToMenu) memset(buf, 0, length_bytes);
@@ -238,6 +368,9 @@ void AudioCallback(void* buf, unsigned int *length, void *userdata)
 /* Release emulation resources */
 void TrashEmulation()
 {
-  pspImageDestroy(Screen);
+  int i;
+  gfx_frame_buffers(NULL, 0);
+  for (i = 0; i < FRAME_BUFFERS; i++)
+    if (Frames[i]) pspImageDestroy(Frames[i]);
 }
 
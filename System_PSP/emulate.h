@@ -1,6 +1,8 @@
 #ifndef _EMULATE_H
 #define _EMULATE_H
 
+#define AUDIO_RATE 44100 /* Output samples per second */
+
 void system_graphics_update();
 
 int  InitEmulation();
@@ -34,6 +34,10 @@
 #define OPTION_SHOW_FPS     6
 #define OPTION_CONTROL_MODE 7
 #define OPTION_ANIMATE      8
+#define OPTION_Z80_THREAD   9
+#define OPTION_DEFER_RENDER 10
+#define OPTION_RENDER_THREAD 11
+#define OPTION_PLANE_CACHE  12
 
 #define SYSTEM_SCRNSHOT     1
 #define SYSTEM_RESET        2
@@ -89,6 +93,7 @@ static const PspMenuOptionDef
     MENU_OPTION("Skip 4 frames",4),
     MENU_OPTION("Skip 5 frames",5),
     MENU_OPTION("Skip 6 frames",6),
+    MENU_OPTION("Automatic",    FRAMESKIP_AUTO),
     MENU_END_OPTIONS
   },
   PspClockFreqOptions[] = {
@@ -137,6 +142,14 @@ static const PspMenuItemDef
       "\026\250\020 Larger values: faster emulation, faster battery depletion (default: 222MHz)"),
     MENU_ITEM("Show FPS counter",    OPTION_SHOW_FPS, ToggleOptions, -1,
       "\026\250\020 Show/hide the frames-per-second counter"),
+    MENU_ITEM("Z80 thread",          OPTION_Z80_THREAD, ToggleOptions, -1,
+      "\026\250\020 Run the sound CPU on a separate thread (multi-core only)"),
+    MENU_ITEM("Render per frame",    OPTION_DEFER_RENDER, ToggleOptions, -1,
+      "\026\250\020 Draw the whole frame at once instead of line by line"),
+    MENU_ITEM("Render thread",       OPTION_RENDER_THREAD, ToggleOptions, -1,
+      "\026\250\020 Draw frames on a separate thread, one frame behind (multi-core only)"),
+    MENU_ITEM("Cache scroll planes", OPTION_PLANE_CACHE, ToggleOptions, -1,
+      "\026\250\020 Keep the background layers decoded, faster when they scroll"),
     MENU_HEADER("Menu"),
     MENU_ITEM("Button mode", OPTION_CONTROL_MODE, ControlModeOptions,  -1, 
       "\026\250\020 Change OK and Cancel button mapping"),
@@ -449,7 +462,12 @@ void LoadOptions()
   /* Load values */
   Options.DisplayMode = pspInitGetInt(init, "Video", "Display Mode", DISPLAY_MODE_UNSCALED);
   Options.UpdateFreq = pspInitGetInt(init, "Video", "Update Frequency", 0);
+  /* Under the old key, frames skipped were presented anyway, once for */
+  /* each setting step. Come down a step, so the old default of skipping */
+  /* one frame still presents every frame. */
   Options.Frameskip = pspInitGetInt(init, "Video", "Frameskip", 1);
+  if (Options.Frameskip > 0) Options.Frameskip--;
+  Options.Frameskip = pspInitGetInt(init, "Video", "Frames Skipped", Options.Frameskip);
   Options.VSync = pspInitGetInt(init, "Video", "VSync", 0);
   Options.ClockFreq = pspInitGetInt(init, "Video", "PSP Clock Frequency", 222);
   Options.ShowFps = pspInitGetInt(init, "Video", "Show FPS", 0);
@@ -458,6 +476,10 @@ void LoadOptions()
   UiMetric.Animate = pspInitGetInt(init, "Menu", "Animate", 1);
 
   mute = !pspInitGetInt(init, "System", "Sound", 1);
+  Options.Z80Thread = pspInitGetInt(init, "System", "Z80 Thread", 0);
+  Options.DeferRender = pspInitGetInt(init, "Video", "Render Per Frame", 0);
+  Options.RenderThread = pspInitGetInt(init, "Video", "Render Thread", 0);
+  Options.PlaneCache = pspInitGetInt(init, "Video", "Plane Cache", 0);
 
   if (GamePath) free(GamePath);
   GamePath = pspInitGetString(init, "File", "Game Path", NULL);
@@ -479,7 +501,7 @@ int SaveOptions()
   /* Set values */
   pspInitSetInt(init, "Video", "Display Mode", Options.DisplayMode);
   pspInitSetInt(init, "Video", "Update Frequency", Options.UpdateFreq);
-  pspInitSetInt(init, "Video", "Frameskip", Options.Frameskip);
+  pspInitSetInt(init, "Video", "Frames Skipped", Options.Frameskip);
   pspInitSetInt(init, "Video", "VSync", Options.VSync);
   pspInitSetInt(init, "Video", "PSP Clock Frequency",Options.ClockFreq);
   pspInitSetInt(init, "Video", "Show FPS", Options.ShowFps);
@@ -488,6 +510,10 @@ int SaveOptions()
   pspInitSetInt(init, "Menu", "Animate", UiMetric.Animate);
 
   pspInitSetInt(init, "System", "Sound", !mute);
+  pspInitSetInt(init, "System", "Z80 Thread", Options.Z80Thread);
+  pspInitSetInt(init, "Video", "Render Per Frame", Options.DeferRender);
+  pspInitSetInt(init, "Video", "Render Thread", Options.RenderThread);
+  pspInitSetInt(init, "Video", "Plane Cache", Options.PlaneCache);
 
   if (GamePath) pspInitSetString(init, "File", "Game Path", GamePath);
 
@@ -547,6 +573,14 @@ void DisplayMenu()
       pspMenuSelectOptionByValue(item, (void*)Options.ClockFreq);
       item = pspMenuFindItemById(OptionUiMenu.Menu, OPTION_SHOW_FPS);
       pspMenuSelectOptionByValue(item, (void*)Options.ShowFps);
+      item = pspMenuFindItemById(OptionUiMenu.Menu, OPTION_Z80_THREAD);
+      pspMenuSelectOptionByValue(item, (void*)Options.Z80Thread);
+      item = pspMenuFindItemById(OptionUiMenu.Menu, OPTION_DEFER_RENDER);
+      pspMenuSelectOptionByValue(item, (void*)Options.DeferRender);
+      item = pspMenuFindItemById(OptionUiMenu.Menu, OPTION_RENDER_THREAD);
+      pspMenuSelectOptionByValue(item, (void*)Options.RenderThread);
+      item = pspMenuFindItemById(OptionUiMenu.Menu, OPTION_PLANE_CACHE);
+      pspMenuSelectOptionByValue(item, (void*)Options.PlaneCache);
       item = pspMenuFindItemById(OptionUiMenu.Menu, OPTION_CONTROL_MODE);
       pspMenuSelectOptionByValue(item, (void*)Options.ControlMode);
       item = pspMenuFindItemById(OptionUiMenu.Menu, OPTION_ANIMATE);
@@ -856,6 +890,14 @@ int OnMenuItemChanged(const struct PspUiMenu *uimenu, PspMenuItem* item,
     case OPTION_SHOW_FPS:
       Options.ShowFps = value; break;
       break;
+    case OPTION_Z80_THREAD:
+      Options.Z80Thread = value; break;
+    case OPTION_DEFER_RENDER:
+      Options.DeferRender = value; break;
+    case OPTION_RENDER_THREAD:
+      Options.RenderThread = value; break;
+    case OPTION_PLANE_CACHE:
+      Options.PlaneCache = value; break;
     case OPTION_CONTROL_MODE:
       Options.ControlMode = value;
       UiMetric.OkButton = (!value) ? PSP_CTRL_CROSS : PSP_CTRL_CIRCLE;
@@ -11,6 +11,8 @@ void TrashMenu();
 #define DISPLAY_MODE_FIT_HEIGHT  1
 #define DISPLAY_MODE_FILL_SCREEN 2
 
+#define FRAMESKIP_AUTO          -1
+
 #define JOY 0x100
 #define SPC 0x200
 
@@ -48,6 +50,10 @@ typedef struct
   int VSync;
   int UpdateFreq;
   int Frameskip;
+  int Z80Thread;
+  int DeferRender;
+  int RenderThread;
+  int PlaneCache;
 } EmulatorOptions;
 
 struct ButtonConfig
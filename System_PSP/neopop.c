@@ -3,11 +3,14 @@
 #include <string.h>
 #include <stdarg.h>
 
+#include <pspkernel.h>
+
 #include "fileio.h"
 #include "image.h"
 #include "video.h"
 
 #include "neopop.h"
+#include "emulate.h"
 
 extern PspImage *Screen;
 extern char *SaveStatePath;
@@ -170,9 +173,34 @@ BOOL system_io_state_write(char* filename, _u8* buffer, _u32 bufferLength)
   /* Write state data */
   fwrite(buffer, bufferLength, sizeof(_u8), f);
   fclose(f);
-
+
   return 1;
 }
+
+/*! Creates the file specified by 'filename' for a stream of writes, such
+  as a capture. Returns NULL on failure. */
+
+void* system_io_stream_open(char* filename)
+{
+  return fopen(filename, "wb");
+}
+
+BOOL system_io_stream_write(void* stream, void* buffer, _u32 bufferLength)
+{
+  return fwrite(buffer, 1, bufferLength, (FILE*)stream) == bufferLength;
+}
+
+void system_io_stream_close(void* stream)
+{
+  fclose((FILE*)stream);
+}
+
+/*! Moves the next write to 'offset' bytes from the start of the stream */
+
+void system_io_stream_seek(void* stream, _u32 offset)
+{
+  fseek((FILE*)stream, offset, SEEK_SET);
+}
 
 /*! Reads the "appropriate" (system specific) flash data into the given
   preallocated buffer. The emulation core doesn't care where from. */
@@ -234,12 +262,84 @@ BOOL system_io_rom_read(char* filename, _u8* buffer, _u32 bufferLength)
   return FALSE;
 }
 
+typedef struct
+{
+  void (*Entry)(void*);
+  void *Param;
+}
+THREAD_START;
+
+static int ThreadEntry(SceSize args, void *argp)
+{
+  THREAD_START *start = (THREAD_START*)argp;
+  start->Entry(start->Param);
+
+  sceKernelExitDeleteThread(0);
+  return 0;
+}
+
+/*! Starts a new thread running 'entry(param)'. Return FALSE on failure */
+
+BOOL system_thread_start(void (*entry)(void*), void* param)
+{
+  THREAD_START start = { entry, param };
+  SceUID thid;
+
+  if ((thid = sceKernelCreateThread("core_thread", ThreadEntry, 
+    0x12, 0x10000, PSP_THREAD_ATTR_USER, NULL)) < 0)
+      return FALSE;
+
+  /* Start parameters are copied to the new thread's stack */
+  if (sceKernelStartThread(thid, sizeof(THREAD_START), &start) < 0)
+  {
+    sceKernelDeleteThread(thid);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/*! Creates a counting semaphore with the given initial count, returns
+  NULL on failure. */
+
+void* system_sem_create(int count)
+{
+  SceUID sema = sceKernelCreateSema("core_sema", 0, count, 0x7fffffff, NULL);
+  return (sema < 0) ? NULL : (void*)sema;
+}
+
+void system_sem_destroy(void* sem)
+{
+  sceKernelDeleteSema((SceUID)sem);
+}
+
+/*! Increments the semaphore count. */
+
+void system_sem_post(void* sem)
+{
+  sceKernelSignalSema((SceUID)sem, 1);
+}
+
+/*! Blocks until the semaphore count is non-zero, then decrements it. */
+
+void system_sem_wait(void* sem)
+{
+  sceKernelWaitSema((SceUID)sem, 1, NULL);
+}
+
+/*! Returns a free running count of microseconds, used for timing. */
+
+_u32 system_get_time()
+{
+  return sceKernelGetSystemTimeLow();
+}
+
 /*! Callback for "sound_init" with the system sound frequency */
   
 void system_sound_chipreset()
 {
-  /* Initialises sound chips, matching frequncies */
-  sound_init(CHIP_FREQUENCY);
+  /* Initialises sound chips at the rate the PSP plays */
+  sound_init(AUDIO_RATE);
 }
 
 /*! Clears the sound output. */